@@ -1,533 +1,6371 @@
-#include <iostream>
-#include <vector>
-#include <fstream>
-#include <sstream>
-#include <unordered_map>
-#include <list>
-#include <algorithm> 
-using namespace std;
-struct MemoryBlock 
-{
-    int start,
-        size,
-        refCount;
-    vector<string> variables; // To store variable names referencing the same memory block
-};
-
-struct FreeBlock 
-{
-    int start,
-        size;
-};
-
-class MemoryManager 
-{
-    private:
-        const int totalMemory;
-        vector<int> memoryArray;
-        list<MemoryBlock> allocatedBlocks;
-        list<FreeBlock> freeBlocks;
-        unordered_map<string, int> variableToAddress;
-    public:
-        
-        /***************************************************************
-        Class Constructor: MemoryManager
-
-        Use: Initializes an instance of the MemoryManager class with
-        a specified size, creating an initial block of memory
-        and setting up the necessary data structures for memory
-        management.
-
-        Arguments: size - an integer representing the total size of the
-        memory managed by the MemoryManager.
-
-        Returns: Nothing.
-
-        Notes: The constructor initializes the totalMemory attribute the specified size 
-        and creates an initial FreeBlock covering the entire memory space. The memoryArray
-        is initialized to zeros, indicating that all memory is initially unallocated. This 
-        class is designed for managing dynamic memory allocation and deallocation, and it uses
-        linked lists to keep track of allocated and free memory blocks. The initial free block 
-        covers the entire memory space, and as memory is allocated and deallocated,these linked lists 
-        are updated accordingly.
-        ***************************************************************/
-
-        MemoryManager(int size) : totalMemory(size), memoryArray(size, 0) 
-        {
-            FreeBlock initialFreeBlock = {0, size};
-            freeBlocks.push_back(initialFreeBlock);
-        }
-
-
-        /***************************************************************
-        Function: allocateMemory
-
-        Use: Allocates a block of memory for a given variable.
-
-        Arguments:
-        1. size: an integer representing the size of the memory block to be allocated.
-        2. variableName: a constant reference to a string representing the name of the 
-                         variable for which memory is to be allocated.
-
-        Returns:
-        -1: If the variable with the given name already has memory allocated.
-        -2: If there is not enough memory available for the requested allocation.
-        startAddress: If memory is successfully allocated, returns the starting address of the allocated block.
-
-        Notes:
-        The function searches for a free block with sufficient size to accommodate the requested memory, if multiple
-        blocks have sufficient size, it allocates the smallest block of memory that is sufficient to accommodate
-        the memory request.
-        If a suitable block is found, it allocates memory, updates the memory array and free block list,
-        and maintains a mapping of the variable name to the allocated memory's starting address.
-        ***************************************************************/
-
-        // int allocateMemory(int size, const string& variableName) 
-        // {
-        //     if (variableToAddress.find(variableName) != variableToAddress.end()) 
-        //     {
-        //         return -1; 
-        //     }
-        //     for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) 
-        //     {
-        //         if (it->size >= size) 
-        //         {
-        //             int startAddress = it->start;
-        //             MemoryBlock newBlock = {startAddress, size, 1, {variableName}};
-        //             allocatedBlocks.push_back(newBlock);
-
-        //             // Update memory array to mark as allocated
-        //             for (int i = startAddress; i < startAddress + size; ++i) 
-        //             {
-        //                 memoryArray[i] = 1;
-        //             }
-
-        //             // Update free block list
-        //             it->start += size;
-        //             it->size -= size;
-        //             if (it->size == 0) 
-        //             {
-        //                 freeBlocks.erase(it);
-        //             }
-
-        //             // Update variable to address mapping
-        //             variableToAddress[variableName] = startAddress;
-
-        //             return startAddress;
-        //         }
-        //     }
-
-        //     return -2; // Not enough memory
-        // }
-        int allocateMemory(int size, const string& variableName, auto &outputFile) // used best fit here.
-        {
-            if (variableName.empty()) 
-            {
-                outputFile << "Variable name cannot be empty. " << variableName << "\n";
-                return -3;
-            }
-            if (isdigit(variableName[0])) 
-            {
-                outputFile << "Variable name cannot start with a digit. " << variableName << "\n";
-                return -3;
-            }
-            if (variableToAddress.find(variableName) != variableToAddress.end()) 
-            {
-                return -1; // Variable already exists
-            }
-
-            auto bestFitBlock = freeBlocks.end(); // Iterator to the best fit block
-            int minSizeDifference = numeric_limits<int>::max(); // Minimum size difference initialized to maximum
-
-            // Iterate through the free blocks to find the best fit
-            for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) 
-            {
-                if (it->size >= size) 
-                {
-                    int sizeDifference = it->size - size;
-
-                    // Update the best fit if the current block has a smaller size difference
-                    if (sizeDifference < minSizeDifference) 
-                    {
-                        bestFitBlock = it;
-                        minSizeDifference = sizeDifference;
-                    }
-                }
-            }
-
-            // Check if a suitable free block is found
-            if (bestFitBlock != freeBlocks.end()) 
-            {
-                int startAddress = bestFitBlock->start;
-                MemoryBlock newBlock = {startAddress, size, 1, {variableName}};
-                allocatedBlocks.push_back(newBlock);
-
-                // Update memory array to mark as allocated
-                for (int i = startAddress; i < startAddress + size; ++i) 
-                {
-                    memoryArray[i] = 1;
-                }
-
-                // Update free block list
-                bestFitBlock->start += size;
-                bestFitBlock->size -= size;
-
-                // If the block is fully allocated, remove it from the free block list
-                if (bestFitBlock->size == 0) 
-                {
-                    freeBlocks.erase(bestFitBlock);
-                }
-
-                // Update variable to address mapping
-                variableToAddress[variableName] = startAddress;
-
-                return startAddress; // Return the start address of the allocated memory block
-            }
-
-            return -2; // Not enough memory
-        }
-
-        
-        /***************************************************************
-        Function: deallocateMemory
-
-        Use:       Deallocates memory for a given variable name.
-
-        Arguments: 1. variableName: a constant reference to a string, representing the name of the variable to deallocate.
-                   2. outputFile: a reference to an output stream, where error or informational messages are written.
-
-        Returns:   1, if memory deallocation is successful, otherwise just writes the case in the output file itself.
-
-        Notes:     This function searches for the specified variable name in the variableToAddress map. 
-                   If found, it decreases the reference count of the associated memory block. If the 
-                   reference count becomes zero, the memory is marked as deallocated in the memory array, 
-                   and the block is either added to the free block list.
-                   If the variable is not found, an error message is written to the output stream. The function 
-                   returns 1 on success.
-        ***************************************************************/
-
-        
-        int deallocateMemory(const string& variableName, auto &outputFile)
-        {
-            auto it = variableToAddress.find(variableName);
-            if (it != variableToAddress.end()) 
-            {
-                int startAddress = it->second;
-                auto blockIt = find_if(allocatedBlocks.begin(), allocatedBlocks.end(),
-                                            [startAddress](const MemoryBlock& block) 
-                                            {
-                                                return block.start == startAddress;
-                                            });
-
-                if (blockIt != allocatedBlocks.end()) 
-                {
-                    // Remove from variable to address mapping
-                    variableToAddress.erase(it);
-                    blockIt->variables.erase(remove(blockIt->variables.begin(), blockIt->variables.end(), variableName), blockIt->variables.end());   
-                    if (--(blockIt->refCount) == 0) 
-                    {
-                        // Update memory array to mark as deallocated
-                        for (int i = startAddress; i < startAddress + blockIt->size; ++i) {
-                            memoryArray[i] = 0;
-                        }
-
-                        // Update free block list
-                        FreeBlock newFreeBlock = {startAddress, blockIt->size};
-                        auto freeBlockIt = freeBlocks.begin();
-                        while (freeBlockIt != freeBlocks.end() && freeBlockIt->start < newFreeBlock.start) {
-                            ++freeBlockIt;
-                        }
-
-                        if (freeBlockIt != freeBlocks.begin() && prev(freeBlockIt)->start + prev(freeBlockIt)->size == newFreeBlock.start) {
-                            prev(freeBlockIt)->size += newFreeBlock.size;
-                        } else {
-                            freeBlocks.insert(freeBlockIt, newFreeBlock);
-                        }
-
-                        allocatedBlocks.erase(blockIt);
-                    }
-                    else
-                    {
-                        outputFile<<"Reference count decreased by one for the block referred by "<<variableName<<endl;
-                        return -1;
-                    }
-                }
-            }
-            else
-            {
-                outputFile<<"Error: Variable " << variableName << " is not allocated.\n";
-                return -1;
-            }
-            return 1;
-        }
-
-        /***************************************************************
-        Function: referenceMemory
-
-        Use:        Associates var1 with the same block of memory as var2,
-                    updating the reference count and memory mapping.
-
-        Arguments: 1. var1: a constant reference to a string representing
-                    the variable to be associated with var2.
-                2. var2: a constant reference to a string representing
-                    the variable whose memory block will be referenced.
-
-        Returns:   -1 if var1 is already present in the variableToAddress map
-                    (indicating allocation failure due to duplicate variable).
-                    true if var1 is successfully associated with the same memory
-                    block as var2, and the reference count and memory mapping
-                    are updated accordingly.
-                    false if there is no block associated with var2.
-
-        Notes:      This function checks if var1 is already present in the
-                    variableToAddress map, and returns -1 in such cases. It then
-                    searches for the block associated with var2 in the allocated
-                    blocks list. If found, var1 is added to the variables list of
-                    the same block, the reference count is increased, and the
-                    variableToAddress mapping is updated. If no block is found
-                    for var2, the function returns false.
-        ***************************************************************/
-        int referenceMemory(const string& var1, const string& var2)
-        {
-            // Check if var1 already exists
-            if (variableToAddress.find(var1) != variableToAddress.end()) 
-            {
-                return -1; // var1 already exists
-            }
-
-            // Find the block associated with var2
-            auto itVar2 = variableToAddress.find(var2);
-            if (itVar2 != variableToAddress.end()) 
-            {
-                int var2StartAddress = itVar2->second;
-
-                // Find the block in allocatedBlocks associated with var2
-                auto blockIt = find_if(allocatedBlocks.begin(), allocatedBlocks.end(),
-                    [var2StartAddress](const auto& block) { return block.start == var2StartAddress; });
-
-                if (blockIt != allocatedBlocks.end()) 
-                {
-                    // Add var1 to the variables of the same block
-                    blockIt->variables.push_back(var1);
-                    // Increase the reference count
-                    blockIt->refCount++;
-
-                    // Update variable to address mapping for var1
-                    variableToAddress[var1] = var2StartAddress;
-
-                    return true; // Reference successful
-                }
-            }
-
-            return false; // No block associated with var2
-        }
-
-        /***************************************************************
-        Function: unfragment
-        Use: Performs memory compaction by re-addressing allocated blocks and updating related data structures.
-        Arguments: totalMemorySize - an integer representing the total size of the memory (in bytes).
-        Returns: Nothing.
-        Notes:
-        This function sorts the memoryArray in descending order, bringing all allocated blocks (1's) to the start and unallocated blocks (0's) to the end.
-        Clears the existing freeBlock list.
-        Re-addresses the allocated blocks, updating their starting addresses and the variableToAddress map.
-        Inserts any remaining memory as a new free block.
-        ***************************************************************/
-        void unfragment(int totalMemorySize) 
-        {
-            // Sort memory array in descending order
-            sort(memoryArray.rbegin(), memoryArray.rend());
-            //This brings all 1's i.e. allocated blocks to the start and all 0's to the end.
-
-            // Clear existing freeBlock list
-            freeBlocks.clear();
-            int currentAddress = 0;
-
-            // Re-address the allocated blocks
-            for (auto& block : allocatedBlocks) 
-            {
-                block.start = currentAddress;
-                currentAddress += block.size;
-                
-                for (const auto& variable : block.variables) 
-                {
-                    variableToAddress[variable] = block.start; // Update variableToAddress map for each variable in the vector
-                }
-            }
-
-            // Insert the remaining memory as a free block
-            if (currentAddress < totalMemorySize) 
-            {
-                FreeBlock freeBlock;
-                freeBlock.start = currentAddress;
-                freeBlock.size = totalMemorySize - currentAddress;
-                freeBlocks.push_back(freeBlock);
-            }
-        }
-        
-        /***************************************************************
-        Function: printMemoryState
-        Use: Prints the current state of memory, including details
-        about allocated and free blocks.
-        Arguments: outputFile - a reference to an output stream (modified by printMemoryState).
-        The function assumes that the stream is open.
-        Returns: nothing
-        Notes: This function iterates over the lists of allocated and free blocks
-        and prints their details to the specified output stream. It calculates
-        and prints the total memory allocated and total memory free.
-        ***************************************************************/
-        void printMemoryState(auto & outputFile ) 
-        {
-            if (outputFile.is_open()) 
-            {
-                int totalfree = 0, totalallocated = 0;
-            outputFile << "\n";
-            outputFile << "Allocated Blocks:\n";
-            for (const auto& block : allocatedBlocks) 
-            {
-                outputFile << "Start: " << block.start << ", Size: " << block.size << ", RefCount: " << block.refCount << ", Variables: ";
-                for (const auto& variable : block.variables) {
-                    outputFile << variable << " ";
-                }
-                outputFile << "\n";
-
-                // Accumulate the total allocated memory size
-                totalallocated += block.size;
-            }
-            outputFile << "Free Blocks:\n";
-            for (const auto& block : freeBlocks) 
-            {
-                outputFile << "Start: " << block.start << ", Size: " << block.size << "\n";
-
-                // Accumulate the total free memory size
-                totalfree += block.size;
-            }
-            outputFile << "Total Memory Allocated: " << totalallocated << " bytes\n";
-            outputFile << "Total Memory Free: " << totalfree << " bytes\n\n";
-            } 
-            else 
-            {
-                // If unable to open the file, print to standard error
-                cerr << "Error opening output file.\n";
-            }
-        }
-
-};
-
-int main(int argc, char* argv[]) 
-{
-    if (argc != 3) 
-    {
-        cerr << "You must pass Total Memory Size and Defragmentation Interval.\n";
-        return 1;
-    }
-    int totalMemorySize = stoi(argv[1]);
-    int k = stoi(argv[2]);
-    if(totalMemorySize < 1)
-    {
-        cerr << "Total Memory should be a natural number. Considering default case as 100. \n";
-        totalMemorySize=100;
-    }
-    if(k < 1)
-    {
-        cerr << "The period after which you want the compaction should occur should be a natural number. \n Considering default case as 1";
-        k=100;
-    }
-    int defragmentationInterval=k;
-    MemoryManager memoryManager(totalMemorySize);
-
-    ifstream inputFile("C:\\Users\\Arbee\\OneDrive\\Desktop\\Moin\\LP01\\input.txt");
-    if (!inputFile.is_open()) 
-    {
-        cerr << "Error opening input file.\n";
-        return 1;
-    }
-
-    ofstream outputFile("C:\\Users\\Arbee\\OneDrive\\Desktop\\Moin\\LP01\\output.txt");
-    if (!outputFile.is_open()) 
-    {
-        cerr << "Error opening output file.\n";
-        return 1;
-    }
-    
-    string line;
-    while (getline(inputFile, line)) 
-    {
-        istringstream iss(line);
-        string transactionType;
-        iss >> transactionType;
-
-        if (transactionType == "allocate")
-        {
-            int size;
-            string variableName;
-            iss >> size >> variableName;
-            int startAddress = memoryManager.allocateMemory(size, variableName, outputFile);
-            if (startAddress >= 0 ) 
-            {
-                outputFile << "Allocated " << size << " bytes for variable " << variableName << " at address " << startAddress << "\n";
-            } else if (startAddress == -2)
-            {
-                outputFile << "Not enough memory for allocation as of now. Trying after eliminating any present fragmentation.\n\n";
-                memoryManager.unfragment(totalMemorySize);
-                startAddress=memoryManager.allocateMemory(size, variableName, outputFile);
-                if (startAddress >= 0 ) 
-                {
-                    outputFile << "Allocated " << size << " bytes for variable " << variableName << " at address " << startAddress << "\n";
-                }
-                else
-                    outputFile << "Error: Still not enough memory for allocation.\n";
-            }
-            else if (startAddress == -1)
-            {
-                outputFile<<"A variable with the same name as '"<< variableName << "' is already present.\nDeallocate it or change the current variable name to something else.\n";
-            }
-            
-        } 
-        else if (transactionType == "free") 
-        {
-            string variableName;
-            iss >> variableName;
-            int status = memoryManager.deallocateMemory(variableName,outputFile);
-            if(status >= 0)
-            {
-                outputFile << "Deallocated memory for variable " << variableName << "\n";
-                defragmentationInterval--;
-                if(defragmentationInterval == 0)
-                {
-                    memoryManager.unfragment(totalMemorySize);
-                    defragmentationInterval=k;
-                }
-            }
-        } 
-        else if (transactionType == "print") 
-        {
-            memoryManager.printMemoryState(outputFile);
-        }
-        else if (transactionType == "reference") 
-        {
-            string var1, var2;
-            iss >> var1 >> var2;
-            int flag=memoryManager.referenceMemory(var1, var2);
-            if (flag==1) 
-            {
-                outputFile << "Reference: " << var1 << " is now referring to the same block as " << var2 << "\n";
-            } 
-            else if(flag==0)
-            {
-                outputFile << "Error: " << var2 << " does not refer to any block.\n\n";
-            } 
-            else
-            {
-                outputFile << "Error: " << var1 << " already refers to a block.\n\n";
-            }
-        }
-        else 
-        {
-            outputFile << "Error: Unknown transaction type.\n";
-        }      
-    }
-    inputFile.close();
-    outputFile.close();
-    return 0;
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <memory>
+#include <map>
+#include <set>
+#include <limits>
+#include <algorithm> 
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <queue>
+#include <deque>
+#include <charconv>
+#include <cstdio>
+#include <type_traits>
+#include <bit>
+#include <cstdint>
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+/***************************************************************
+Class: SmallVector
+
+Use: A vector of trivially copyable items that keeps up to
+InlineCapacity of them inside the object and only allocates once
+there are more.
+
+Notes: The heap vector holds every item while there are more than
+InlineCapacity, and the items move back inside when they fit again,
+so an empty or small SmallVector never owns heap memory. Removal
+moves the last item into the gap (swapRemove), so it is O(1) but
+does not keep the order.
+***************************************************************/
+template <typename T, size_t InlineCapacity>
+class SmallVector
+{
+    private:
+        array<T, InlineCapacity> inlineItems{};
+        size_t inlineCount = 0;
+        vector<T> heapItems; // Every item while there are more than InlineCapacity
+    public:
+        size_t size() const { return heapItems.empty() ? inlineCount : heapItems.size(); }
+        bool empty() const { return size() == 0; }
+        T* begin() { return heapItems.empty() ? inlineItems.data() : heapItems.data(); }
+        T* end() { return begin() + size(); }
+        const T* begin() const { return heapItems.empty() ? inlineItems.data() : heapItems.data(); }
+        const T* end() const { return begin() + size(); }
+        T& operator[](size_t index) { return begin()[index]; }
+        const T& operator[](size_t index) const { return begin()[index]; }
+        T& back() { return begin()[size() - 1]; }
+
+        void push_back(const T& item)
+        {
+            if (!heapItems.empty()) 
+            {
+                heapItems.push_back(item);
+            }
+            else if (inlineCount < InlineCapacity) 
+            {
+                inlineItems[inlineCount++] = item;
+            }
+            else 
+            {
+                heapItems.reserve(2 * InlineCapacity);
+                heapItems.assign(inlineItems.begin(), inlineItems.end());
+                heapItems.push_back(item);
+                inlineCount = 0;
+            }
+        }
+
+        // Removes the item at index by moving the last item into its place
+        void swapRemove(size_t index)
+        {
+            T* items = begin();
+            items[index] = items[size() - 1];
+            if (heapItems.empty()) 
+            {
+                inlineCount--;
+                return;
+            }
+            heapItems.pop_back();
+            if (heapItems.size() == InlineCapacity) 
+            {
+                copy(heapItems.begin(), heapItems.end(), inlineItems.begin());
+                inlineCount = InlineCapacity;
+                vector<T>().swap(heapItems);
+            }
+        }
+};
+
+template <typename Address>
+struct MemoryBlock 
+{
+    Address start,
+            size;
+    int refCount;
+    SmallVector<int, 4> variables; // Symbol IDs of the variables referencing the same memory block
+    int handle = -1; // Stable handle of the block, see MemoryManager::handleOf
+    int slab = -1; // ID of the SlabCache slab holding the block, -1 if the placement policy placed it
+};
+
+template <typename Address>
+struct FreeBlock 
+{
+    Address start,
+            size;
+};
+
+// One allocation of a batch: the size and the variable to bind
+struct AllocationRequest
+{
+    long long size;
+    string_view variableName;
+};
+
+struct CompactionResult
+{
+    long long bytesMoved;
+    int blocksMoved;
+};
+
+// Limits on one incremental compaction step, 0 meaning no limit
+struct CompactionBudget
+{
+    long long bytes;
+    int blocks;
+    chrono::nanoseconds time;
+};
+
+// Lets the binary trace writer's symbol map be searched with a string_view without building a string
+struct StringHash
+{
+    using is_transparent = void;
+    size_t operator()(string_view text) const { return hash<string_view>{}(text); }
+};
+
+/***************************************************************
+Class: SymbolTable
+
+Use: Interns variable names, giving every name a small integer ID
+that the memory manager uses in place of the string.
+
+Notes: IDs are dense, so per-variable data can be kept in flat
+arrays indexed by ID. A name is hashed once when it is looked up or
+interned, and is stored once: the index maps views of the stored
+names, which a deque never moves. An ID is given back with release
+when its variable is freed and reused by the next new name, so the
+table only grows with the number of variables alive at the same time.
+***************************************************************/
+class SymbolTable
+{
+    private:
+        deque<string> names; // ID -> name, empty for released IDs
+        unordered_map<string_view, int> ids; // Name -> ID, viewing the strings in names
+        vector<int> freeIds;
+    public:
+        // The ID of name, or -1 if it is not interned
+        int find(string_view name) const
+        {
+            auto it = ids.find(name);
+            return it == ids.end() ? -1 : it->second;
+        }
+
+        // The ID of name, interning it first if needed
+        int intern(string_view name)
+        {
+            auto it = ids.find(name);
+            if (it != ids.end()) 
+            {
+                return it->second;
+            }
+            int id;
+            if (freeIds.empty()) 
+            {
+                id = static_cast<int>(names.size());
+                names.emplace_back(name);
+            }
+            else 
+            {
+                id = freeIds.back();
+                freeIds.pop_back();
+                names[id] = name;
+            }
+            ids.emplace(names[id], id);
+            return id;
+        }
+
+        // Forgets an ID's name so the ID can be reused
+        void release(int id)
+        {
+            ids.erase(names[id]);
+            names[id].clear();
+            freeIds.push_back(id);
+        }
+
+        const string& name(int id) const { return names[id]; }
+
+        // Every ID in use is below this
+        int capacity() const { return static_cast<int>(names.size()); }
+};
+
+/***************************************************************
+Class: OccupancyBitmap
+
+Use: Records which bytes of the simulated memory are allocated,
+using one bit per byte packed into 64-bit words.
+
+Notes: Ranges are filled and cleared a whole word at a time, and
+with 256-bit AVX2 stores when the compiler targets AVX2 (a scalar
+word loop is used otherwise). Counting uses popcount per word and
+the zero run search skips fully allocated words without looking at
+individual bits. Bits past the end of the memory in the last word
+are kept set, so they never look like free space.
+***************************************************************/
+template <typename Address>
+class OccupancyBitmap
+{
+    private:
+        Address bitCount;
+        int paddingBits;
+        vector<uint64_t> words;
+
+        static constexpr uint64_t allOnes = ~uint64_t(0);
+
+        /***************************************************************
+        Function: fillWords
+
+        Use: Sets the words in [first, last) to the given value.
+
+        Arguments: 1. first: index of the first word to fill.
+                   2. last: one past the index of the last word to fill.
+                   3. value: allOnes to mark bytes allocated, 0 to mark them free.
+
+        Returns: Nothing.
+        ***************************************************************/
+        void fillWords(size_t first, size_t last, uint64_t value)
+        {
+#if defined(__AVX2__)
+            __m256i fill = _mm256_set1_epi64x(static_cast<long long>(value));
+            for (; first + 4 <= last; first += 4)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(&words[first]), fill);
+            }
+#endif
+            for (; first < last; ++first)
+            {
+                words[first] = value;
+            }
+        }
+
+        /***************************************************************
+        Function: skipFullWords
+
+        Use: Finds the first word at or after a given index that has at
+        least one free byte in it.
+
+        Arguments: first - index of the word to start from.
+
+        Returns: The index of that word, or words.size() if there is none.
+        ***************************************************************/
+        size_t skipFullWords(size_t first) const
+        {
+#if defined(__AVX2__)
+            __m256i full = _mm256_set1_epi64x(-1);
+            for (; first + 4 <= words.size(); first += 4)
+            {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&words[first]));
+                if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(block, full)) != -1)
+                {
+                    break;
+                }
+            }
+#endif
+            while (first < words.size() && words[first] == allOnes)
+            {
+                ++first;
+            }
+            return first;
+        }
+
+        /***************************************************************
+        Function: applyRange
+
+        Use: Sets or clears every bit in [start, start + length).
+
+        Arguments: 1. start: first byte of the range.
+                   2. length: number of bytes in the range.
+                   3. allocated: true to set the bits, false to clear them.
+
+        Returns: Nothing.
+        ***************************************************************/
+        void applyRange(Address start, Address length, bool allocated)
+        {
+            if (length <= 0)
+            {
+                return;
+            }
+            size_t firstWord = start / 64, lastWord = (start + length - 1) / 64;
+            uint64_t headMask = allOnes << (start % 64);
+            uint64_t tailMask = allOnes >> (63 - (start + length - 1) % 64);
+            if (firstWord == lastWord)
+            {
+                headMask &= tailMask;
+            }
+            words[firstWord] = allocated ? (words[firstWord] | headMask) : (words[firstWord] & ~headMask);
+            if (firstWord == lastWord)
+            {
+                return;
+            }
+            fillWords(firstWord + 1, lastWord, allocated ? allOnes : 0);
+            words[lastWord] = allocated ? (words[lastWord] | tailMask) : (words[lastWord] & ~tailMask);
+        }
+    public:
+        // Ranges that lie in different 64-byte aligned pieces share no word, so threads may change them at once
+        static constexpr bool concurrentRanges = true;
+
+        explicit OccupancyBitmap(Address size) : bitCount(size), paddingBits(static_cast<int>((64 - size % 64) % 64)), words((size + 63) / 64, 0)
+        {
+            if (paddingBits > 0)
+            {
+                words.back() = allOnes << (64 - paddingBits);
+            }
+        }
+
+        void setRange(Address start, Address length) { applyRange(start, length, true); }
+        void clearRange(Address start, Address length) { applyRange(start, length, false); }
+
+        /***************************************************************
+        Function: countRange
+
+        Use: Counts the allocated bytes in [start, start + length).
+
+        Arguments: 1. start: first byte of the range.
+                   2. length: number of bytes in the range.
+
+        Returns: The number of allocated bytes in the range.
+        ***************************************************************/
+        Address countRange(Address start, Address length) const
+        {
+            if (length <= 0)
+            {
+                return 0;
+            }
+            size_t firstWord = start / 64, lastWord = (start + length - 1) / 64;
+            uint64_t headMask = allOnes << (start % 64);
+            uint64_t tailMask = allOnes >> (63 - (start + length - 1) % 64);
+            if (firstWord == lastWord)
+            {
+                return popcount(words[firstWord] & headMask & tailMask);
+            }
+            Address count = popcount(words[firstWord] & headMask) + popcount(words[lastWord] & tailMask);
+            for (size_t i = firstWord + 1; i < lastWord; ++i)
+            {
+                count += popcount(words[i]);
+            }
+            return count;
+        }
+
+        /***************************************************************
+        Function: count
+
+        Use: Counts all allocated bytes.
+
+        Arguments: None.
+
+        Returns: The number of allocated bytes in the whole memory.
+        ***************************************************************/
+        Address count() const
+        {
+            Address total = 0;
+            for (uint64_t word : words)
+            {
+                total += popcount(word);
+            }
+            return total - paddingBits;
+        }
+
+        /***************************************************************
+        Function: findZeroRun
+
+        Use: Finds the lowest address of a run of at least length free bytes.
+
+        Arguments: length - the number of contiguous free bytes wanted.
+
+        Returns: The start of the first such run, or -1 if there is none.
+
+        Notes: Words with no free byte are skipped in bulk while no run
+        is in progress. Inside a mixed word, runs of zeros and ones are
+        measured with countr_zero and countr_one rather than bit by bit.
+        ***************************************************************/
+        Address findZeroRun(Address length) const
+        {
+            Address runStart = 0, runLength = 0;
+            for (size_t w = 0; w < words.size(); ++w)
+            {
+                if (runLength == 0)
+                {
+                    w = skipFullWords(w);
+                    if (w == words.size())
+                    {
+                        break;
+                    }
+                }
+                uint64_t word = words[w];
+                int bit = 0;
+                while (bit < 64)
+                {
+                    uint64_t rest = word >> bit;
+                    int zeros = rest == 0 ? 64 - bit : countr_zero(rest);
+                    if (zeros > 0)
+                    {
+                        if (runLength == 0)
+                        {
+                            runStart = static_cast<Address>(w * 64) + bit;
+                        }
+                        runLength += zeros;
+                        if (runLength >= length)
+                        {
+                            return runStart;
+                        }
+                        bit += zeros;
+                    }
+                    if (bit < 64)
+                    {
+                        runLength = 0;
+                        bit += countr_one(word >> bit);
+                    }
+                }
+            }
+            return -1;
+        }
+
+        /***************************************************************
+        Function: findNext
+
+        Use: Finds the first allocated, or the first free, byte at or
+        after a given address.
+
+        Arguments: 1. from: the address to start at.
+                   2. allocated: true to look for an allocated byte, false for a free one.
+
+        Returns: The address of that byte, or -1 if there is none.
+
+        Notes: Words that cannot hold a match are skipped whole, fully
+        allocated ones with the same AVX2 scan findZeroRun uses.
+        ***************************************************************/
+        Address findNext(Address from, bool allocated) const
+        {
+            if (from < 0 || from >= bitCount)
+            {
+                return -1;
+            }
+            size_t w = from / 64;
+            uint64_t word = (allocated ? words[w] : ~words[w]) & (allOnes << (from % 64));
+            while (word == 0)
+            {
+                if (allocated)
+                {
+                    while (++w < words.size() && words[w] == 0) {}
+                }
+                else
+                {
+                    w = skipFullWords(w + 1);
+                }
+                if (w == words.size())
+                {
+                    return -1;
+                }
+                word = allocated ? words[w] : ~words[w];
+            }
+            Address found = static_cast<Address>(w * 64) + countr_zero(word);
+            return found < bitCount ? found : -1;
+        }
+
+        Address size() const { return bitCount; }
+};
+
+/***************************************************************
+Class: ExtentMap
+
+Use: Records which bytes of the simulated memory are allocated as
+a set of allocated extents. It has the same interface as
+OccupancyBitmap and stands in for it in an extent-only memory
+manager.
+
+Notes: The extents are kept in an address ordered map from start
+to end, and extents that touch are always joined, so the map holds
+one entry per run of adjacent blocks. Its size depends only on the
+number of blocks, never on the memory size, so a heap of many
+gigabytes costs a few words per run instead of one bit per byte.
+Setting or clearing a range is a map lookup plus the joining or
+splitting of the extents it touches, counting a range walks the
+extents in it, and the total of allocated bytes is kept up to date,
+so count is O(1). Unlike the bitmap, only one thread at a time may
+change it.
+***************************************************************/
+template <typename Address>
+class ExtentMap
+{
+    private:
+        Address byteCount,
+                allocatedBytes = 0;
+        map<Address, Address> extents; // start -> end of every maximal allocated run
+
+        // The first extent that ends after address, or extents.end()
+        typename map<Address, Address>::const_iterator extentAfter(Address address) const
+        {
+            auto extentIt = extents.upper_bound(address);
+            if (extentIt != extents.begin() && prev(extentIt)->second > address) 
+            {
+                --extentIt;
+            }
+            return extentIt;
+        }
+    public:
+        static constexpr bool concurrentRanges = false;
+
+        explicit ExtentMap(Address size) : byteCount(size) {}
+
+        // Marks [start, start + length) allocated, joining it with every extent it overlaps or touches
+        void setRange(Address start, Address length)
+        {
+            if (length <= 0) 
+            {
+                return;
+            }
+            Address end = start + length;
+            auto extentIt = extents.upper_bound(start);
+            if (extentIt != extents.begin() && prev(extentIt)->second >= start) 
+            {
+                --extentIt;
+                start = extentIt->first;
+            }
+            while (extentIt != extents.end() && extentIt->first <= end) 
+            {
+                end = max(end, extentIt->second);
+                allocatedBytes -= extentIt->second - extentIt->first;
+                extentIt = extents.erase(extentIt);
+            }
+            extents.emplace_hint(extentIt, start, end);
+            allocatedBytes += end - start;
+        }
+
+        // Marks [start, start + length) free, cutting the extents it overlaps
+        void clearRange(Address start, Address length)
+        {
+            if (length <= 0) 
+            {
+                return;
+            }
+            Address end = start + length;
+            auto extentIt = extentAfter(start);
+            while (extentIt != extents.end() && extentIt->first < end) 
+            {
+                Address extentStart = extentIt->first,
+                        extentEnd = extentIt->second;
+                allocatedBytes -= extentEnd - extentStart;
+                extentIt = extents.erase(extentIt);
+                if (extentStart < start) 
+                {
+                    extents.emplace_hint(extentIt, extentStart, start);
+                    allocatedBytes += start - extentStart;
+                }
+                if (extentEnd > end) 
+                {
+                    extents.emplace_hint(extentIt, end, extentEnd);
+                    allocatedBytes += extentEnd - end;
+                }
+            }
+        }
+
+        // The number of allocated bytes in [start, start + length)
+        Address countRange(Address start, Address length) const
+        {
+            Address end = start + length,
+                    count = 0;
+            for (auto extentIt = extentAfter(start); extentIt != extents.end() && extentIt->first < end; ++extentIt) 
+            {
+                count += min(end, extentIt->second) - max(start, extentIt->first);
+            }
+            return count;
+        }
+
+        Address count() const { return allocatedBytes; }
+
+        // The lowest address of a run of at least length free bytes, or -1
+        Address findZeroRun(Address length) const
+        {
+            Address gapStart = 0;
+            for (const auto& [start, end] : extents) 
+            {
+                if (start - gapStart >= length) 
+                {
+                    return gapStart;
+                }
+                gapStart = end;
+            }
+            return byteCount - gapStart >= length ? gapStart : -1;
+        }
+
+        // The first allocated, or the first free, byte at or after from, or -1
+        Address findNext(Address from, bool allocated) const
+        {
+            if (from < 0 || from >= byteCount) 
+            {
+                return -1;
+            }
+            auto extentIt = extentAfter(from);
+            bool inside = extentIt != extents.end() && extentIt->first <= from;
+            if (allocated) 
+            {
+                return inside ? from : extentIt == extents.end() ? -1 : extentIt->first;
+            }
+            // Extents never touch, so the end of the one holding from is free
+            Address found = inside ? extentIt->second : from;
+            return found < byteCount ? found : -1;
+        }
+
+        Address size() const { return byteCount; }
+};
+
+/***************************************************************
+Class: PlacementPolicy
+
+Use: Decides where in memory a new block is placed and keeps
+track of the free space.
+
+Notes: MemoryManager owns one policy and calls it for every
+allocation, deallocation and compaction, so all policies share
+the same transaction and print behaviour. A policy may round
+request sizes up through blockSize (the buddy allocator does);
+the rounded size is what gets recorded for the block. Address is
+the signed integer type of addresses and sizes, int or int64_t, so
+-1 stays free to mean "no address".
+***************************************************************/
+template <typename Address>
+class PlacementPolicy
+{
+    public:
+        virtual ~PlacementPolicy() = default;
+
+        // Name used on the command line
+        virtual string name() const = 0;
+
+        // Number of bytes actually reserved for a request of size bytes
+        virtual Address blockSize(Address size) const { return size; }
+
+        // Reserves size bytes and returns their start address, or -1 if no free block fits
+        virtual Address allocate(Address size) = 0;
+
+        // Returns [start, start + size) to the free space
+        virtual void release(Address start, Address size) = 0;
+
+        // Forgets all free space, then makes [start, start + size) the only free space
+        virtual void reset(Address start, Address size) = 0;
+
+        // All free blocks in address order
+        virtual vector<FreeBlock<Address>> freeBlockList() const = 0;
+
+        // Size of the largest free block, 0 if there is none
+        virtual Address largestFreeBlock() const = 0;
+
+        // Number of free blocks, i.e. holes
+        virtual int freeBlockCount() const = 0;
+
+        // Start of the lowest addressed free block, -1 if there is none
+        virtual Address lowestFreeAddress() const = 0;
+
+        // Takes [start, start + size) out of the free space. start must begin a free
+        // block, and the range must be covered by free blocks that follow each other.
+        virtual void claim(Address start, Address size) = 0;
+
+        // Reserves blocks of the given sizes, one after another in a single free block if one
+        // can hold them all, otherwise one by one. Sets each address, or -1 where nothing fits.
+        virtual void allocateBatch(const vector<Address>& sizes, vector<Address>& addresses)
+        {
+            long long total = accumulate(sizes.begin(), sizes.end(), 0LL);
+            Address start = total > 0 && total <= numeric_limits<Address>::max() ? allocate(static_cast<Address>(total)) : -1;
+            addresses.resize(sizes.size());
+            for (size_t i = 0; i < sizes.size(); ++i) 
+            {
+                if (start >= 0) 
+                {
+                    addresses[i] = start;
+                    start += sizes[i];
+                }
+                else 
+                {
+                    addresses[i] = allocate(sizes[i]);
+                }
+            }
+        }
+
+        // Returns blocks sorted by address, which do not overlap, to the free space. Blocks
+        // that touch are joined first, so each run of them is released once.
+        virtual void releaseBatch(const vector<FreeBlock<Address>>& blocks)
+        {
+            forEachRun(blocks, [this](Address start, Address size) { release(start, size); });
+        }
+    protected:
+        // Calls visit(start, size) for every run of touching blocks, in address order
+        template <typename Visit>
+        static void forEachRun(const vector<FreeBlock<Address>>& blocks, Visit visit)
+        {
+            size_t i = 0;
+            while (i < blocks.size()) 
+            {
+                Address start = blocks[i].start,
+                        end = start + blocks[i].size;
+                while (++i < blocks.size() && blocks[i].start == end) 
+                {
+                    end += blocks[i].size;
+                }
+                visit(start, end - start);
+            }
+        }
+};
+
+/***************************************************************
+Class: FitPolicy
+
+Use: Common base of the first, next, best and worst fit policies.
+
+Notes: Free blocks are kept in an address ordered map (start -> size)
+and a (size, start) set. Subclasses only choose which free block to
+carve a request from. A released block is merged into the free
+block just before it, if the two touch. releaseBatch merges every
+run of released blocks with the free blocks on both sides.
+***************************************************************/
+template <typename Address>
+class FitPolicy : public PlacementPolicy<Address>
+{
+    protected:
+        using PlacementPolicy<Address>::forEachRun;
+
+        map<Address, Address> freeBlocks; // start -> size, ordered by address
+        set<pair<Address, Address>> freeBlocksBySize; // (size, start), ordered for size lookups
+
+        void insertFreeBlock(Address start, Address size)
+        {
+            freeBlocks[start] = size;
+            freeBlocksBySize.insert({size, start});
+        }
+
+        void eraseFreeBlock(typename map<Address, Address>::iterator freeBlockIt)
+        {
+            freeBlocksBySize.erase({freeBlockIt->second, freeBlockIt->first});
+            freeBlocks.erase(freeBlockIt);
+        }
+
+        // Start address of the free block to allocate from, or -1 if none fits
+        virtual Address choose(Address size) = 0;
+    public:
+        Address allocate(Address size) override
+        {
+            Address startAddress = choose(size);
+            if (startAddress < 0) 
+            {
+                return -1;
+            }
+            auto freeBlockIt = freeBlocks.find(startAddress);
+            Address freeSize = freeBlockIt->second;
+            eraseFreeBlock(freeBlockIt);
+            if (freeSize > size) 
+            {
+                insertFreeBlock(startAddress + size, freeSize - size);
+            }
+            return startAddress;
+        }
+
+        void release(Address start, Address size) override
+        {
+            auto freeBlockIt = freeBlocks.lower_bound(start);
+            if (freeBlockIt != freeBlocks.begin() && prev(freeBlockIt)->first + prev(freeBlockIt)->second == start) 
+            {
+                auto previousBlock = prev(freeBlockIt);
+                Address mergedStart = previousBlock->first;
+                Address mergedSize = previousBlock->second + size;
+                eraseFreeBlock(previousBlock);
+                insertFreeBlock(mergedStart, mergedSize);
+            } 
+            else 
+            {
+                insertFreeBlock(start, size);
+            }
+        }
+
+        void releaseBatch(const vector<FreeBlock<Address>>& blocks) override
+        {
+            forEachRun(blocks, [this](Address start, Address size)
+            {
+                Address end = start + size;
+                auto nextIt = freeBlocks.lower_bound(start);
+                if (nextIt != freeBlocks.begin() && prev(nextIt)->first + prev(nextIt)->second == start) 
+                {
+                    start = prev(nextIt)->first;
+                    eraseFreeBlock(prev(nextIt));
+                }
+                if (nextIt != freeBlocks.end() && nextIt->first == end) 
+                {
+                    end += nextIt->second;
+                    auto followingIt = next(nextIt);
+                    eraseFreeBlock(nextIt);
+                    nextIt = followingIt;
+                }
+                freeBlocks.emplace_hint(nextIt, start, end - start);
+                freeBlocksBySize.insert({end - start, start});
+            });
+        }
+
+        void reset(Address start, Address size) override
+        {
+            freeBlocks.clear();
+            freeBlocksBySize.clear();
+            if (size > 0) 
+            {
+                insertFreeBlock(start, size);
+            }
+        }
+
+        vector<FreeBlock<Address>> freeBlockList() const override
+        {
+            vector<FreeBlock<Address>> blocks;
+            blocks.reserve(freeBlocks.size());
+            for (const auto& [start, size] : freeBlocks) 
+            {
+                blocks.push_back({start, size});
+            }
+            return blocks;
+        }
+
+        Address largestFreeBlock() const override { return freeBlocksBySize.empty() ? 0 : freeBlocksBySize.rbegin()->first; }
+        int freeBlockCount() const override { return static_cast<int>(freeBlocks.size()); }
+        Address lowestFreeAddress() const override { return freeBlocks.empty() ? -1 : freeBlocks.begin()->first; }
+
+        void claim(Address start, Address size) override
+        {
+            Address end = start + size;
+            while (start < end) 
+            {
+                auto freeBlockIt = freeBlocks.find(start);
+                Address blockEnd = start + freeBlockIt->second;
+                eraseFreeBlock(freeBlockIt);
+                if (blockEnd > end) 
+                {
+                    // The rest is joined with the free block after it, so compaction leaves one block at the top
+                    auto nextIt = freeBlocks.find(blockEnd);
+                    Address restEnd = blockEnd;
+                    if (nextIt != freeBlocks.end()) 
+                    {
+                        restEnd += nextIt->second;
+                        eraseFreeBlock(nextIt);
+                    }
+                    insertFreeBlock(end, restEnd - end);
+                }
+                start = blockEnd;
+            }
+        }
+};
+
+// Lowest addressed free block that fits. O(n) in the number of free blocks.
+template <typename Address>
+class FirstFitPolicy : public FitPolicy<Address>
+{
+    protected:
+        using FitPolicy<Address>::freeBlocks;
+
+        Address choose(Address size) override
+        {
+            for (const auto& [start, freeSize] : freeBlocks) 
+            {
+                if (freeSize >= size) 
+                {
+                    return start;
+                }
+            }
+            return -1;
+        }
+    public:
+        string name() const override { return "first"; }
+};
+
+// First free block that fits at or after the end of the previous allocation, wrapping around once.
+template <typename Address>
+class NextFitPolicy : public FitPolicy<Address>
+{
+    private:
+        Address rover = 0;
+    protected:
+        using FitPolicy<Address>::freeBlocks;
+
+        Address choose(Address size) override
+        {
+            auto roverIt = freeBlocks.lower_bound(rover);
+            for (auto it = roverIt; it != freeBlocks.end(); ++it) 
+            {
+                if (it->second >= size) 
+                {
+                    rover = it->first + size;
+                    return it->first;
+                }
+            }
+            for (auto it = freeBlocks.begin(); it != roverIt; ++it) 
+            {
+                if (it->second >= size) 
+                {
+                    rover = it->first + size;
+                    return it->first;
+                }
+            }
+            return -1;
+        }
+    public:
+        string name() const override { return "next"; }
+
+        void reset(Address start, Address size) override
+        {
+            FitPolicy<Address>::reset(start, size);
+            rover = 0;
+        }
+};
+
+// Smallest free block that fits, lowest address first among equal sizes. O(log n).
+template <typename Address>
+class BestFitPolicy : public FitPolicy<Address>
+{
+    protected:
+        using FitPolicy<Address>::freeBlocksBySize;
+
+        Address choose(Address size) override
+        {
+            auto bestFitBlock = freeBlocksBySize.lower_bound({size, numeric_limits<Address>::min()});
+            return bestFitBlock == freeBlocksBySize.end() ? -1 : bestFitBlock->second;
+        }
+    public:
+        string name() const override { return "best"; }
+};
+
+// Largest free block, lowest address first among equal sizes. O(log n).
+template <typename Address>
+class WorstFitPolicy : public FitPolicy<Address>
+{
+    protected:
+        using FitPolicy<Address>::freeBlocksBySize;
+
+        Address choose(Address size) override
+        {
+            if (freeBlocksBySize.empty() || freeBlocksBySize.rbegin()->first < size) 
+            {
+                return -1;
+            }
+            return freeBlocksBySize.lower_bound({freeBlocksBySize.rbegin()->first, numeric_limits<Address>::min()})->second;
+        }
+    public:
+        string name() const override { return "worst"; }
+};
+
+/***************************************************************
+Class: TLSFPolicy
+
+Use: Two-level segregated fit allocator with O(1) allocation and
+release.
+
+Notes: Free blocks are grouped by size into classes. The first level
+is the power of two of the size and the second level splits each
+power of two into 16 equal ranges. Each class holds a doubly linked
+list of free blocks, and one bitmap per level marks the non-empty
+classes. A request is rounded up to the next class boundary, so the
+first block in any non-empty class at or above it fits, and that
+class is found with two count-trailing-zeros operations. If rounding
+skips every class, the request's own class is scanned as a last
+resort, so a fitting block is never missed. Freed blocks are merged
+with both neighbours straight away. The neighbours are found through
+hash maps keyed by start and end address, which stand in for the
+boundary tags of a real TLSF heap. TLSF keeps no order by address or
+by exact size, so the lowest free address and the largest free block,
+which the defragmentation scheduler asks for after every free, come
+from two heaps of the free blocks. insertNode pushes onto them and
+removeNode leaves its entries behind; a query pops stale entries off
+the top, and the heaps are rebuilt once they hold twice as many
+entries as there are free blocks, so both are O(log n) amortized.
+***************************************************************/
+template <typename Address>
+class TLSFPolicy : public PlacementPolicy<Address>
+{
+    private:
+        using Unsigned = make_unsigned_t<Address>;
+
+        static constexpr int secondLevelBits = 4;
+        static constexpr int secondLevelCount = 1 << secondLevelBits;
+        static constexpr int firstLevelCount = numeric_limits<Address>::digits + 1;
+
+        struct Node
+        {
+            Address size,
+                    prev,
+                    next;
+        };
+
+        unordered_map<Address, Node> nodes; // start -> free block
+        unordered_map<Address, Address> startByEnd; // end -> start of the free block ending there
+        Address heads[firstLevelCount][secondLevelCount];
+        uint64_t firstLevelBitmap = 0;
+        uint32_t secondLevelBitmap[firstLevelCount] = {};
+        mutable vector<Address> lowestStarts; // Min-heap of free block starts, may hold stale entries
+        mutable vector<pair<Address, Address>> largestBlocks; // Max-heap of (size, start) of free blocks, may hold stale entries
+
+        static void mapping(Address size, int& firstLevel, int& secondLevel)
+        {
+            if (size < secondLevelCount) 
+            {
+                firstLevel = 0;
+                secondLevel = size;
+                return;
+            }
+            int topBit = bit_width(static_cast<Unsigned>(size)) - 1;
+            firstLevel = topBit - secondLevelBits + 1;
+            secondLevel = static_cast<int>(size >> (topBit - secondLevelBits)) - secondLevelCount;
+        }
+
+        void insertNode(Address start, Address size)
+        {
+            int firstLevel, secondLevel;
+            mapping(size, firstLevel, secondLevel);
+            Address head = heads[firstLevel][secondLevel];
+            nodes[start] = {size, -1, head};
+            if (head >= 0) 
+            {
+                nodes[head].prev = start;
+            }
+            heads[firstLevel][secondLevel] = start;
+            startByEnd[start + size] = start;
+            firstLevelBitmap |= uint64_t(1) << firstLevel;
+            secondLevelBitmap[firstLevel] |= 1u << secondLevel;
+            if (max(lowestStarts.size(), largestBlocks.size()) > 2 * nodes.size() + 64) 
+            {
+                rebuildHeaps();
+            }
+            else 
+            {
+                lowestStarts.push_back(start);
+                push_heap(lowestStarts.begin(), lowestStarts.end(), greater<>());
+                largestBlocks.push_back({size, start});
+                push_heap(largestBlocks.begin(), largestBlocks.end());
+            }
+        }
+
+        // Refills the heaps from the free blocks, dropping every stale entry
+        void rebuildHeaps()
+        {
+            lowestStarts.clear();
+            largestBlocks.clear();
+            for (const auto& [start, node] : nodes) 
+            {
+                lowestStarts.push_back(start);
+                largestBlocks.push_back({node.size, start});
+            }
+            make_heap(lowestStarts.begin(), lowestStarts.end(), greater<>());
+            make_heap(largestBlocks.begin(), largestBlocks.end());
+        }
+
+        void removeNode(Address start)
+        {
+            Node node = nodes[start];
+            int firstLevel, secondLevel;
+            mapping(node.size, firstLevel, secondLevel);
+            if (node.prev >= 0) 
+            {
+                nodes[node.prev].next = node.next;
+            } 
+            else 
+            {
+                heads[firstLevel][secondLevel] = node.next;
+            }
+            if (node.next >= 0) 
+            {
+                nodes[node.next].prev = node.prev;
+            }
+            if (heads[firstLevel][secondLevel] < 0) 
+            {
+                secondLevelBitmap[firstLevel] &= ~(1u << secondLevel);
+                if (secondLevelBitmap[firstLevel] == 0) 
+                {
+                    firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+                }
+            }
+            startByEnd.erase(start + node.size);
+            nodes.erase(start);
+        }
+
+        // Start of a free block of at least size bytes, or -1
+        Address findBlock(Address size) const
+        {
+            int firstLevel, secondLevel;
+            Address roundUp = 0;
+            if (size >= secondLevelCount) 
+            {
+                roundUp = (Address(1) << (bit_width(static_cast<Unsigned>(size)) - 1 - secondLevelBits)) - 1;
+            }
+            if (size <= numeric_limits<Address>::max() - roundUp) 
+            {
+                mapping(size + roundUp, firstLevel, secondLevel);
+                uint32_t secondLevelMap = secondLevelBitmap[firstLevel] & (~0u << secondLevel);
+                if (secondLevelMap == 0 && firstLevel + 1 < firstLevelCount) 
+                {
+                    uint64_t firstLevelMap = firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1));
+                    if (firstLevelMap != 0) 
+                    {
+                        firstLevel = countr_zero(firstLevelMap);
+                        secondLevelMap = secondLevelBitmap[firstLevel];
+                    }
+                }
+                if (secondLevelMap != 0) 
+                {
+                    return heads[firstLevel][countr_zero(secondLevelMap)];
+                }
+            }
+
+            // Rounding skipped every class; the request's own class may still hold a large enough block
+            mapping(size, firstLevel, secondLevel);
+            for (Address start = heads[firstLevel][secondLevel]; start >= 0; start = nodes.at(start).next) 
+            {
+                if (nodes.at(start).size >= size) 
+                {
+                    return start;
+                }
+            }
+            return -1;
+        }
+    public:
+        TLSFPolicy()
+        {
+            reset(0, 0);
+        }
+
+        string name() const override { return "tlsf"; }
+
+        Address allocate(Address size) override
+        {
+            Address startAddress = findBlock(size);
+            if (startAddress < 0) 
+            {
+                return -1;
+            }
+            Address freeSize = nodes[startAddress].size;
+            removeNode(startAddress);
+            if (freeSize > size) 
+            {
+                insertNode(startAddress + size, freeSize - size);
+            }
+            return startAddress;
+        }
+
+        void release(Address start, Address size) override
+        {
+            auto leftIt = startByEnd.find(start);
+            if (leftIt != startByEnd.end()) 
+            {
+                Address leftStart = leftIt->second;
+                size += start - leftStart;
+                start = leftStart;
+                removeNode(leftStart);
+            }
+            auto rightIt = nodes.find(start + size);
+            if (rightIt != nodes.end()) 
+            {
+                Address rightStart = rightIt->first;
+                size += rightIt->second.size;
+                removeNode(rightStart);
+            }
+            insertNode(start, size);
+        }
+
+        void reset(Address start, Address size) override
+        {
+            nodes.clear();
+            startByEnd.clear();
+            for (auto& row : heads) 
+            {
+                fill(begin(row), end(row), -1);
+            }
+            firstLevelBitmap = 0;
+            fill(begin(secondLevelBitmap), end(secondLevelBitmap), 0);
+            lowestStarts.clear();
+            largestBlocks.clear();
+            if (size > 0) 
+            {
+                insertNode(start, size);
+            }
+        }
+
+        vector<FreeBlock<Address>> freeBlockList() const override
+        {
+            vector<FreeBlock<Address>> blocks;
+            blocks.reserve(nodes.size());
+            for (const auto& [start, node] : nodes) 
+            {
+                blocks.push_back({start, node.size});
+            }
+            sort(blocks.begin(), blocks.end(), [](const FreeBlock<Address>& a, const FreeBlock<Address>& b) { return a.start < b.start; });
+            return blocks;
+        }
+
+        Address largestFreeBlock() const override
+        {
+            while (!largestBlocks.empty()) 
+            {
+                auto [size, start] = largestBlocks.front();
+                auto nodeIt = nodes.find(start);
+                if (nodeIt != nodes.end() && nodeIt->second.size == size) 
+                {
+                    return size;
+                }
+                pop_heap(largestBlocks.begin(), largestBlocks.end());
+                largestBlocks.pop_back();
+            }
+            return 0;
+        }
+
+        int freeBlockCount() const override { return static_cast<int>(nodes.size()); }
+
+        Address lowestFreeAddress() const override
+        {
+            while (!lowestStarts.empty()) 
+            {
+                if (nodes.contains(lowestStarts.front())) 
+                {
+                    return lowestStarts.front();
+                }
+                pop_heap(lowestStarts.begin(), lowestStarts.end(), greater<>());
+                lowestStarts.pop_back();
+            }
+            return -1;
+        }
+
+        void claim(Address start, Address size) override
+        {
+            Address end = start + size;
+            while (start < end) 
+            {
+                Address blockEnd = start + nodes.at(start).size;
+                removeNode(start);
+                if (blockEnd > end) 
+                {
+                    insertNode(end, blockEnd - end);
+                }
+                start = blockEnd;
+            }
+        }
+};
+
+/***************************************************************
+Class: BuddyPolicy
+
+Use: Binary buddy allocator over power-of-two sized, naturally
+aligned chunks.
+
+Notes: Requests are rounded up to the next power of two. There is
+one address ordered free list per chunk order, so allocation takes
+the lowest chunk of the smallest large enough order and splits it
+down, and release merges a chunk with its buddy for as long as the
+buddy is free. Both are O(log n). Memory that is not a single
+aligned power of two, such as a heap whose size is not a power of
+two or the free tail left by compaction, is split into the largest
+aligned chunks that cover it. Compaction can leave allocated blocks
+unaligned; they are split the same way when freed.
+***************************************************************/
+template <typename Address>
+class BuddyPolicy : public PlacementPolicy<Address>
+{
+    private:
+        using Unsigned = make_unsigned_t<Address>;
+
+        static constexpr int orderCount = numeric_limits<Address>::digits;
+        vector<set<Address>> freeLists = vector<set<Address>>(orderCount);
+
+        void insertChunk(Address start, int order)
+        {
+            while (order + 1 < orderCount) 
+            {
+                Address buddy = start ^ (Address(1) << order);
+                auto buddyIt = freeLists[order].find(buddy);
+                if (buddyIt == freeLists[order].end()) 
+                {
+                    break;
+                }
+                freeLists[order].erase(buddyIt);
+                start = min(start, buddy);
+                order++;
+            }
+            freeLists[order].insert(start);
+        }
+    public:
+        string name() const override { return "buddy"; }
+
+        Address blockSize(Address size) const override
+        {
+            return size > (Address(1) << (orderCount - 1)) ? size : static_cast<Address>(bit_ceil(static_cast<Unsigned>(size)));
+        }
+
+        Address allocate(Address size) override
+        {
+            int order = bit_width(static_cast<Unsigned>(size) - 1);
+            int available = order;
+            while (available < orderCount && freeLists[available].empty()) 
+            {
+                available++;
+            }
+            if (available >= orderCount) 
+            {
+                return -1;
+            }
+            Address startAddress = *freeLists[available].begin();
+            freeLists[available].erase(freeLists[available].begin());
+
+            // Split down to the requested order, keeping the upper halves free
+            while (available > order) 
+            {
+                available--;
+                freeLists[available].insert(startAddress + (Address(1) << available));
+            }
+            return startAddress;
+        }
+
+        void release(Address start, Address size) override
+        {
+            long long end = static_cast<long long>(start) + size;
+            while (start < end) 
+            {
+                int alignment = start == 0 ? orderCount - 1 : countr_zero(static_cast<Unsigned>(start));
+                int fit = bit_width(static_cast<unsigned long long>(end - start)) - 1;
+                int order = min({alignment, fit, orderCount - 1});
+                insertChunk(start, order);
+                start += Address(1) << order;
+            }
+        }
+
+        void reset(Address start, Address size) override
+        {
+            for (auto& freeList : freeLists) 
+            {
+                freeList.clear();
+            }
+            release(start, size);
+        }
+
+        // Placing a batch together would round its total up to a power of two and lose the rest
+        void allocateBatch(const vector<Address>& sizes, vector<Address>& addresses) override
+        {
+            addresses.resize(sizes.size());
+            for (size_t i = 0; i < sizes.size(); ++i) 
+            {
+                addresses[i] = allocate(sizes[i]);
+            }
+        }
+
+        vector<FreeBlock<Address>> freeBlockList() const override
+        {
+            vector<FreeBlock<Address>> blocks;
+            for (int order = 0; order < orderCount; ++order) 
+            {
+                for (Address start : freeLists[order]) 
+                {
+                    blocks.push_back({start, Address(1) << order});
+                }
+            }
+            sort(blocks.begin(), blocks.end(), [](const FreeBlock<Address>& a, const FreeBlock<Address>& b) { return a.start < b.start; });
+            return blocks;
+        }
+
+        Address largestFreeBlock() const override
+        {
+            for (int order = orderCount - 1; order >= 0; --order) 
+            {
+                if (!freeLists[order].empty()) 
+                {
+                    return Address(1) << order;
+                }
+            }
+            return 0;
+        }
+
+        int freeBlockCount() const override
+        {
+            size_t count = 0;
+            for (const auto& freeList : freeLists) 
+            {
+                count += freeList.size();
+            }
+            return static_cast<int>(count);
+        }
+
+        Address lowestFreeAddress() const override
+        {
+            Address lowest = -1;
+            for (const auto& freeList : freeLists) 
+            {
+                if (!freeList.empty() && (lowest < 0 || *freeList.begin() < lowest)) 
+                {
+                    lowest = *freeList.begin();
+                }
+            }
+            return lowest;
+        }
+
+        // Takes out the chunks from start on and frees what the last one has past the range again
+        void claim(Address start, Address size) override
+        {
+            long long position = start, end = position + size;
+            while (position < end) 
+            {
+                int order = 0;
+                while (freeLists[order].erase(static_cast<Address>(position)) == 0) 
+                {
+                    order++;
+                }
+                long long chunkEnd = position + (1LL << order);
+                if (chunkEnd > end) 
+                {
+                    release(static_cast<Address>(end), static_cast<Address>(chunkEnd - end));
+                }
+                position = chunkEnd;
+            }
+        }
+};
+
+/***************************************************************
+Function: makePlacementPolicy
+
+Use: Creates a placement policy for Address addresses from its command line name.
+
+Arguments: name - one of first, next, best, worst, tlsf or buddy.
+
+Returns: The new policy, or nullptr if the name is not recognised.
+***************************************************************/
+template <typename Address>
+unique_ptr<PlacementPolicy<Address>> makePlacementPolicy(const string& name)
+{
+    if (name == "first") return make_unique<FirstFitPolicy<Address>>();
+    if (name == "next") return make_unique<NextFitPolicy<Address>>();
+    if (name == "best") return make_unique<BestFitPolicy<Address>>();
+    if (name == "worst") return make_unique<WorstFitPolicy<Address>>();
+    if (name == "tlsf") return make_unique<TLSFPolicy<Address>>();
+    if (name == "buddy") return make_unique<BuddyPolicy<Address>>();
+    return nullptr;
+}
+
+/***************************************************************
+Struct: SlabStatistics
+
+Use: The counters a SlabCache keeps about the requests it served.
+***************************************************************/
+struct SlabStatistics
+{
+    long long requests = 0, // Allocations small enough for a slab
+              hits = 0, // Served from a slab that already existed
+              slabsCreated = 0,
+              slabsReturned = 0, // Empty slabs handed back to the placement policy
+              fallbacks = 0; // No slab had room and none could be carved, so the general path was used
+};
+
+/***************************************************************
+Class: SlabCache
+
+Use: Serves small allocations from slabs, one size class per slab,
+carved from the placement policy's free space.
+
+Notes: Size classes are multiples of 16 bytes up to the largest size
+the cache serves. A slab holds 64 slots of its class, and a 64-bit
+word marks the used ones, so a slot is found with one count of
+trailing zeros and released by clearing one bit. Each class keeps
+the slabs that have a free slot in a vector, and each slab knows its
+position there, so a slab joins or leaves it in O(1). A slab whose
+last slot is freed goes back to the placement policy, except that
+one empty slab per class is kept so that a repeated allocate and
+free of one size does not carve and return a slab every time. The
+slots hold ordinary blocks of the requested size; the rest of each
+slot and the free slots are reserved but unallocated, which is the
+cache's overhead. The cache does not know about the blocks, so the
+memory manager dissolves it before compacting.
+***************************************************************/
+template <typename Address>
+class SlabCache
+{
+    public:
+        static constexpr int slotsPerSlab = 64;
+        static constexpr int classGranularity = 16;
+        static constexpr int largestSlotSize = 4096; // Larger blocks are not small objects, and their slabs would pin too much of the heap
+
+        struct Slab
+        {
+            Address start;
+            int bytes, // Reserved from the placement policy, slotsPerSlab slots or more if the policy rounds up
+                slotSize;
+            uint64_t used; // Bit i is set while slot i holds a block
+            int partialIndex; // Position in its class's partial slabs, -1 if full or not in use
+        };
+    private:
+        int maxSize = 0;
+        vector<Slab> slabs; // Indexed by slab ID, bytes is 0 for unused IDs
+        vector<int> freeSlabIds;
+        vector<vector<int>> partialSlabs; // Per class, the slabs with a free slot
+        vector<int> emptySlab; // Per class, the one empty slab kept, or -1
+        int liveSlabs = 0;
+        long long slabBytes = 0, // Reserved by all slabs
+                  usedBytes = 0; // Held by the blocks in them
+        SlabStatistics counters;
+
+        int classOf(int size) const { return (size - 1) / classGranularity; }
+
+        void addPartial(int slab)
+        {
+            auto& partial = partialSlabs[classOf(slabs[slab].slotSize)];
+            slabs[slab].partialIndex = static_cast<int>(partial.size());
+            partial.push_back(slab);
+        }
+
+        void removePartial(int slab)
+        {
+            auto& partial = partialSlabs[classOf(slabs[slab].slotSize)];
+            int index = slabs[slab].partialIndex;
+            partial[index] = partial.back();
+            slabs[partial[index]].partialIndex = index;
+            partial.pop_back();
+            slabs[slab].partialIndex = -1;
+        }
+
+        // Hands a slab's memory back to the placement policy and frees its ID
+        void returnSlab(int slab, PlacementPolicy<Address>& placement)
+        {
+            if (slabs[slab].partialIndex >= 0) 
+            {
+                removePartial(slab);
+            }
+            placement.release(slabs[slab].start, slabs[slab].bytes);
+            slabBytes -= slabs[slab].bytes;
+            slabs[slab].bytes = 0;
+            liveSlabs--;
+            freeSlabIds.push_back(slab);
+            counters.slabsReturned++;
+        }
+    public:
+        // Serves allocations of up to size bytes (at most largestSlotSize), 0 turns the cache off. Only call while it holds no slabs.
+        void configure(int size)
+        {
+            size = min(size, largestSlotSize);
+            maxSize = size > 0 ? (size + classGranularity - 1) / classGranularity * classGranularity : 0;
+            partialSlabs.assign(maxSize / classGranularity, {});
+            emptySlab.assign(maxSize / classGranularity, -1);
+        }
+
+        bool enabled() const { return maxSize > 0; }
+        bool serves(long long size) const { return size > 0 && size <= maxSize; }
+        int maxSlabSize() const { return maxSize; }
+        int slabCount() const { return liveSlabs; }
+        long long reservedBytes() const { return slabBytes; }
+        long long heldBytes() const { return usedBytes; }
+        const SlabStatistics& statistics() const { return counters; }
+        const vector<Slab>& allSlabs() const { return slabs; }
+
+        /***************************************************************
+        Function: allocate
+
+        Use: Takes a slot for a block of size bytes, which serves must accept.
+
+        Arguments: 1. size: the block size.
+                   2. placement: the policy to carve a new slab from if no slab of the class has room.
+                   3. slab: receives the ID of the slab holding the slot.
+
+        Returns: The start address of the slot, or -1 if no slab has room and no new one fits.
+        ***************************************************************/
+        Address allocate(int size, PlacementPolicy<Address>& placement, int& slab)
+        {
+            counters.requests++;
+            int sizeClass = classOf(size);
+            if (partialSlabs[sizeClass].empty()) 
+            {
+                int slotSize = (sizeClass + 1) * classGranularity;
+                Address bytes = placement.blockSize(static_cast<Address>(slotSize) * slotsPerSlab);
+                Address start = bytes <= numeric_limits<int>::max() ? placement.allocate(bytes) : -1;
+                if (start < 0) 
+                {
+                    counters.fallbacks++;
+                    return -1;
+                }
+                if (freeSlabIds.empty()) 
+                {
+                    freeSlabIds.push_back(static_cast<int>(slabs.size()));
+                    slabs.push_back({});
+                }
+                slab = freeSlabIds.back();
+                freeSlabIds.pop_back();
+                slabs[slab] = {start, static_cast<int>(bytes), slotSize, 0, -1};
+                addPartial(slab);
+                slabBytes += bytes;
+                liveSlabs++;
+                counters.slabsCreated++;
+            }
+            else 
+            {
+                slab = partialSlabs[sizeClass].back();
+                counters.hits++;
+            }
+            Slab& target = slabs[slab];
+            if (emptySlab[sizeClass] == slab) 
+            {
+                emptySlab[sizeClass] = -1;
+            }
+            int slot = countr_zero(~target.used);
+            target.used |= uint64_t(1) << slot;
+            if (target.used == ~uint64_t(0)) 
+            {
+                removePartial(slab);
+            }
+            usedBytes += size;
+            return target.start + slot * target.slotSize;
+        }
+
+        /***************************************************************
+        Function: release
+
+        Use: Frees the slot of a block.
+
+        Arguments: 1. slab: the slab holding the block.
+                   2. start: the block's start address.
+                   3. size: the block's size.
+                   4. placement: the policy that gets the slab back if it is now empty.
+
+        Returns: Nothing.
+        ***************************************************************/
+        void release(int slab, Address start, int size, PlacementPolicy<Address>& placement)
+        {
+            Slab& target = slabs[slab];
+            if (target.used == ~uint64_t(0)) 
+            {
+                addPartial(slab);
+            }
+            target.used &= ~(uint64_t(1) << ((start - target.start) / target.slotSize));
+            usedBytes -= size;
+            if (target.used == 0) 
+            {
+                int sizeClass = classOf(target.slotSize);
+                if (emptySlab[sizeClass] >= 0) 
+                {
+                    returnSlab(emptySlab[sizeClass], placement);
+                }
+                emptySlab[sizeClass] = slab;
+            }
+        }
+
+        // Returns the empty slabs kept for reuse to the placement policy. Returns true if there were any.
+        bool releaseEmpty(PlacementPolicy<Address>& placement)
+        {
+            bool released = false;
+            for (int& slab : emptySlab) 
+            {
+                if (slab >= 0) 
+                {
+                    returnSlab(slab, placement);
+                    slab = -1;
+                    released = true;
+                }
+            }
+            return released;
+        }
+
+        // Forgets every slab without touching the placement policy; the caller takes over their memory
+        void clear()
+        {
+            slabs.clear();
+            freeSlabIds.clear();
+            for (auto& partial : partialSlabs) 
+            {
+                partial.clear();
+            }
+            fill(emptySlab.begin(), emptySlab.end(), -1);
+            liveSlabs = 0;
+            slabBytes = 0;
+            usedBytes = 0;
+        }
+};
+
+/***************************************************************
+Class: OutputSink
+
+Use: Collects the messages of a replay in a large buffer and writes
+them to the output file in big chunks.
+
+Notes: Every message is started with message(level). Levels are
+Errors (something failed), Summary (print, check and compaction
+reports) and Full (every transaction result); the sink keeps only
+the messages at or below its verbosity, and Silent keeps nothing.
+Text of dropped messages is never formatted. In JSON-lines mode each
+message becomes one JSON object holding the transaction number and
+type, the level, any fields added with field(), and the message text.
+A sink opened with an empty path discards everything. A pipelined
+replay sets a writer, which is then given every full buffer instead
+of the sink writing it, so the file is written on another thread.
+***************************************************************/
+class OutputSink
+{
+    public:
+        enum Level { Silent, Errors, Summary, Full };
+    private:
+        ofstream file;
+        bool discard = true;
+        string buffer;
+        Level verbosity = Full;
+        bool jsonLines = false;
+        bool passing = true;
+        Level messageLevel = Full;
+        string jsonFields,
+               jsonText;
+        long long transactionNumber = 0;
+        string transactionType;
+        function<void(string&)> writer;
+
+        void appendEscaped(string& target, string_view text)
+        {
+            for (char character : text) 
+            {
+                switch (character) 
+                {
+                    case '"': target += "\\\""; break;
+                    case '\\': target += "\\\\"; break;
+                    case '\n': target += "\\n"; break;
+                    case '\r': target += "\\r"; break;
+                    case '\t': target += "\\t"; break;
+                    default:
+                        if (static_cast<unsigned char>(character) < 0x20) 
+                        {
+                            char escape[8];
+                            snprintf(escape, sizeof(escape), "\\u%04x", character);
+                            target += escape;
+                        }
+                        else 
+                        {
+                            target += character;
+                        }
+                }
+            }
+        }
+
+        // Closes the current JSON record, if any
+        void finishMessage()
+        {
+            if (!jsonLines || !passing || (jsonFields.empty() && jsonText.empty())) 
+            {
+                jsonFields.clear();
+                jsonText.clear();
+                return;
+            }
+            static const char* levelNames[] = {"silent", "error", "summary", "info"};
+            buffer += "{\"transaction\":";
+            buffer += to_string(transactionNumber);
+            buffer += ",\"type\":\"";
+            appendEscaped(buffer, transactionType);
+            buffer += "\",\"level\":\"";
+            buffer += levelNames[messageLevel];
+            buffer += "\"";
+            buffer += jsonFields;
+            while (!jsonText.empty() && jsonText.back() == '\n') 
+            {
+                jsonText.pop_back();
+            }
+            if (!jsonText.empty()) 
+            {
+                buffer += ",\"message\":\"";
+                appendEscaped(buffer, jsonText);
+                buffer += "\"";
+            }
+            buffer += "}\n";
+            jsonFields.clear();
+            jsonText.clear();
+            flushIfFull();
+        }
+
+        void flushIfFull()
+        {
+            if (buffer.size() >= (1 << 20)) 
+            {
+                flush();
+            }
+        }
+
+        void append(string_view text)
+        {
+            if (!passing) 
+            {
+                return;
+            }
+            if (jsonLines) 
+            {
+                jsonText += text;
+                return;
+            }
+            buffer += text;
+            flushIfFull();
+        }
+    public:
+        OutputSink()
+        {
+            buffer.reserve(1 << 20 | 1 << 16);
+        }
+
+        ~OutputSink()
+        {
+            close();
+        }
+
+        /***************************************************************
+        Function: open
+
+        Use: Opens the output file and sets the verbosity and format.
+
+        Arguments: 1. path: the output file, or an empty string to discard all output.
+                   2. level: the most detailed level of message to keep.
+                   3. json: true for JSON-lines records instead of text.
+
+        Returns: true if the file could be opened.
+        ***************************************************************/
+        bool open(const string& path, Level level, bool json)
+        {
+            verbosity = level;
+            jsonLines = json;
+            passing = messageLevel <= verbosity;
+            discard = path.empty();
+            if (!discard) 
+            {
+                file.open(path, ios::binary);
+            }
+            return is_open();
+        }
+
+        bool is_open() const { return discard || file.is_open(); }
+        bool json() const { return jsonLines; }
+        bool enabled(Level level) const { return level != Silent && level <= verbosity; }
+
+        // Marks the start of the next transaction, for JSON records
+        void beginTransaction(string_view type)
+        {
+            finishMessage();
+            transactionNumber++;
+            if (jsonLines) 
+            {
+                transactionType = type;
+            }
+        }
+
+        // Starts a new message of the given level
+        OutputSink& message(Level level)
+        {
+            finishMessage();
+            messageLevel = level;
+            passing = enabled(level);
+            return *this;
+        }
+
+        OutputSink& field(string_view key, long long value)
+        {
+            return rawField(key, to_string(value));
+        }
+
+        OutputSink& field(string_view key, string_view value)
+        {
+            if (passing && jsonLines) 
+            {
+                jsonFields += ",\"";
+                jsonFields += key;
+                jsonFields += "\":\"";
+                appendEscaped(jsonFields, value);
+                jsonFields += "\"";
+            }
+            return *this;
+        }
+
+        // Adds a field whose value is already JSON, such as an array
+        OutputSink& rawField(string_view key, string_view value)
+        {
+            if (passing && jsonLines) 
+            {
+                jsonFields += ",\"";
+                jsonFields += key;
+                jsonFields += "\":";
+                jsonFields += value;
+            }
+            return *this;
+        }
+
+        // Escapes text for use inside a JSON string
+        string escape(string_view text)
+        {
+            string escaped;
+            appendEscaped(escaped, text);
+            return escaped;
+        }
+
+        OutputSink& operator<<(string_view text) { append(text); return *this; }
+        OutputSink& operator<<(const char* text) { append(text); return *this; }
+        OutputSink& operator<<(const string& text) { append(text); return *this; }
+        OutputSink& operator<<(char character) { append(string_view(&character, 1)); return *this; }
+
+        template <typename Number>
+        requires is_arithmetic_v<Number>
+        OutputSink& operator<<(Number value)
+        {
+            if (passing) 
+            {
+                char digits[32];
+                auto result = to_chars(begin(digits), end(digits), value);
+                append(string_view(digits, result.ptr - digits));
+            }
+            return *this;
+        }
+
+        // Writes the buffered output to the file, or passes it to the writer
+        void flush()
+        {
+            if (writer && !buffer.empty()) 
+            {
+                writer(buffer);
+            }
+            else 
+            {
+                write(buffer);
+            }
+            buffer.clear();
+        }
+
+        // Sets the function that takes over full buffers (it may swap them out), or removes it when given nullptr
+        void setWriter(function<void(string&)> target)
+        {
+            writer = std::move(target);
+        }
+
+        // Writes text straight to the file, bypassing the buffer
+        void write(string_view text)
+        {
+            if (!discard && !text.empty()) 
+            {
+                file.write(text.data(), text.size());
+            }
+        }
+
+        void close()
+        {
+            finishMessage();
+            flush();
+            if (file.is_open()) 
+            {
+                file.close();
+            }
+        }
+};
+
+/***************************************************************
+Class: LatencyHistogram
+
+Use: Counts durations in power of two buckets of nanoseconds.
+
+Notes: Bucket 0 holds durations of 0 ns and bucket i holds durations
+in [2^(i-1), 2^i) ns. Recording is a bit_width and two additions, so
+it can stay enabled. Percentiles are reported as the upper bound of
+the bucket they fall in.
+***************************************************************/
+class LatencyHistogram
+{
+    public:
+        static constexpr int bucketCount = 40; // The last bucket starts at about 4.6 minutes
+    private:
+        array<long long, bucketCount> buckets{};
+        long long samples = 0,
+                  totalNanoseconds = 0,
+                  maxNanoseconds = 0;
+    public:
+        void record(long long nanoseconds)
+        {
+            buckets[min(static_cast<int>(bit_width(static_cast<unsigned long long>(nanoseconds))), bucketCount - 1)]++;
+            samples++;
+            totalNanoseconds += nanoseconds;
+            maxNanoseconds = max(maxNanoseconds, nanoseconds);
+        }
+
+        long long count() const { return samples; }
+        long long total() const { return totalNanoseconds; }
+        long long maximum() const { return maxNanoseconds; }
+        long long mean() const { return samples == 0 ? 0 : totalNanoseconds / samples; }
+        long long bucket(int index) const { return buckets[index]; }
+
+        // Upper bound of the bucket holding the given fraction of the samples, 0 if there are none
+        long long percentile(double fraction) const
+        {
+            long long seen = 0,
+                      rank = static_cast<long long>(ceil(fraction * samples));
+            for (int index = 0; index < bucketCount && samples > 0; ++index) 
+            {
+                seen += buckets[index];
+                if (seen >= max(rank, 1LL)) 
+                {
+                    return min(index == 0 ? 0LL : (1LL << index) - 1, maxNanoseconds);
+                }
+            }
+            return 0;
+        }
+};
+
+/***************************************************************
+Struct: OperationStatistics
+
+Use: Call count, failure count and latency of one kind of
+MemoryManager operation.
+***************************************************************/
+struct OperationStatistics
+{
+    long long calls = 0,
+              failures = 0;
+    LatencyHistogram latency;
+};
+
+/***************************************************************
+Struct: AllocatorStatistics
+
+Use: The counters a MemoryManager keeps about its own operations.
+***************************************************************/
+struct AllocatorStatistics
+{
+    OperationStatistics allocate,
+                        free,
+                        reference,
+                        unfragment,
+                        compactStep,
+                        compactToFit,
+                        allocateBatch,
+                        freeBatch;
+    long long bytesMoved = 0,
+              blocksMoved = 0;
+};
+
+/***************************************************************
+Class: OperationTimer
+
+Use: Times one MemoryManager operation from its construction to its
+destruction and records it in the operation's statistics.
+
+Notes: fail marks the operation as failed and passes its status code
+through, so a failing path can be written as return timer.fail(-2).
+***************************************************************/
+class OperationTimer
+{
+    private:
+        OperationStatistics& statistics;
+        chrono::steady_clock::time_point start;
+    public:
+        explicit OperationTimer(OperationStatistics& statistics) : statistics(statistics), start(chrono::steady_clock::now()) {}
+        OperationTimer(const OperationTimer&) = delete;
+        OperationTimer& operator=(const OperationTimer&) = delete;
+
+        int fail(int status)
+        {
+            statistics.failures++;
+            return status;
+        }
+
+        ~OperationTimer()
+        {
+            statistics.calls++;
+            statistics.latency.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        }
+};
+
+/***************************************************************
+Class: WorkerPool
+
+Use: A fixed set of threads that run the same task together, used
+by the parallel compaction.
+
+Notes: run calls the task once for every worker index in
+[0, size()) and returns when all of them have finished. The calling
+thread runs index 0, so a pool of size n starts n - 1 threads. The
+threads sleep on a condition variable between tasks.
+***************************************************************/
+class WorkerPool
+{
+    private:
+        vector<thread> threads;
+        mutex lock;
+        condition_variable wake,
+                           finished;
+        const function<void(int)>* task = nullptr;
+        long long generation = 0;
+        int pending = 0;
+        bool stopping = false;
+
+        void workerLoop(int index)
+        {
+            long long seen = 0;
+            unique_lock<mutex> guard(lock);
+            while (true) 
+            {
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping) 
+                {
+                    return;
+                }
+                seen = generation;
+                guard.unlock();
+                (*task)(index);
+                guard.lock();
+                if (--pending == 0) 
+                {
+                    finished.notify_one();
+                }
+            }
+        }
+    public:
+        explicit WorkerPool(int size)
+        {
+            for (int index = 1; index < size; ++index) 
+            {
+                threads.emplace_back(&WorkerPool::workerLoop, this, index);
+            }
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        ~WorkerPool()
+        {
+            {
+                lock_guard<mutex> guard(lock);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& worker : threads) 
+            {
+                worker.join();
+            }
+        }
+
+        int size() const { return static_cast<int>(threads.size()) + 1; }
+
+        void run(const function<void(int)>& work)
+        {
+            {
+                lock_guard<mutex> guard(lock);
+                task = &work;
+                pending = static_cast<int>(threads.size());
+                generation++;
+            }
+            wake.notify_all();
+            work(0);
+            unique_lock<mutex> guard(lock);
+            finished.wait(guard, [&] { return pending == 0; });
+        }
+};
+
+/***************************************************************
+Class: MemoryManager
+
+Use: Simulates a heap of a fixed size, with variables bound to the
+blocks allocated in it, and compacts it on request.
+
+Notes: Address is the signed integer type of addresses and sizes:
+int for heaps of up to 2 GB, int64_t beyond. Occupancy records
+which bytes are allocated. OccupancyBitmap keeps one bit per byte
+and ExtentMap keeps only the allocated extents, so with ExtentMap
+(the extent-only mode) nothing in the manager grows with the memory
+size, and every operation, compaction included, costs in proportion
+to the blocks and holes it touches.
+***************************************************************/
+template <typename Address, typename Occupancy = OccupancyBitmap<Address>>
+class MemoryManager 
+{
+    public:
+        using AddressType = Address;
+    private:
+        using Block = MemoryBlock<Address>;
+        using BlockIterator = typename list<Block>::iterator;
+
+        const Address totalMemory;
+        Occupancy memoryArray;
+        list<Block> allocatedBlocks;
+        unordered_map<Address, BlockIterator> blockAtAddress; // start -> block in allocatedBlocks
+        unique_ptr<PlacementPolicy<Address>> placement; // Owns the free space and decides where blocks go
+        Address allocatedBytes = 0; // Sum of the sizes of allocatedBlocks
+        // The block a variable refers to and the variable's index in the block's variables
+        struct VariableBinding
+        {
+            BlockIterator block;
+            int slot = -1; // -1 while the symbol is not an allocated variable
+        };
+
+        SymbolTable symbols; // Variable names and their IDs
+        vector<VariableBinding> variableBindings; // Symbol ID -> binding, kept across compaction since list iterators are stable
+        AllocatorStatistics statistics; // Counters and latencies of the operations below
+        vector<char> arena; // Payload bytes, empty unless the manager owns a real arena
+        vector<Address> handleTable; // handle -> start address of its block, -1 once the block is freed
+        vector<int> freeHandles; // Released handles, reused by later allocations
+        unique_ptr<WorkerPool> workers; // Runs compaction in parallel, null for serial compaction
+        Address densePrefix = 0; // Every byte below this is allocated, so incremental compaction starts here
+        Address sweepHole = -1, // After a move, [sweepHole, sweepEnd) is known to be free until something is allocated in it
+                sweepEnd = 0;
+        SlabCache<Address> slabCache; // Serves small blocks when enabled with setSlabMaxSize
+
+        // Compactions moving fewer blocks and bytes than this stay serial
+        static constexpr size_t parallelCompactionBlocks = 4096;
+        static constexpr int parallelCompactionBytes = 1 << 22;
+        bool trackChanges = false; // Set by the first print delta
+        unordered_map<Address, bool> changedAddresses; // start -> whether a block started there at the last listing print
+
+        // Records that the block at start is about to change, before blockAtAddress is updated
+        void markChanged(Address start)
+        {
+            if (trackChanges) 
+            {
+                changedAddresses.try_emplace(start, blockAtAddress.count(start) > 0);
+            }
+        }
+
+        // Pointer to bytes [offset, offset + length) of a handle's payload, nullptr if they are not all inside the block
+        char* payloadRange(int handle, Address offset, Address length)
+        {
+            Address start = resolveHandle(handle);
+            if (arena.empty() || start < 0 || offset < 0 || length < 0 || offset + length > blockAtAddress.at(start)->size) 
+            {
+                return nullptr;
+            }
+            return arena.data() + start + offset;
+        }
+
+        // Moves length payload bytes from source down to target, which may overlap
+        void movePayload(Address target, Address source, Address length)
+        {
+            if (!arena.empty() && length > 0) 
+            {
+                memmove(arena.data() + target, arena.data() + source, length);
+            }
+        }
+
+        /***************************************************************
+        Function: moveLowestBlock
+        Use: Moves the first allocated block above the lowest hole down to the start of the hole.
+        Arguments: limit - the largest block to move, 0 for any size.
+        Returns: The size of the block that was moved, or 0 if the memory is already
+        dense or the block is larger than limit.
+        Notes: The block's old range is released to the placement policy and its new one
+        claimed, which works for every policy because nothing below the hole is free.
+        The bitmap, the payload, blockAtAddress and the handle table
+        are updated for this one block, so the manager is consistent after every move.
+        The hole and the block are found from densePrefix with findNext. While the same hole
+        slides up, the block search starts at the end of the last block moved, so a large
+        hole is not scanned again for every block. Moving blocks
+        this way, lowest first, gives the same layout as unfragment once nothing is left to move.
+        ***************************************************************/
+        Address moveLowestBlock(long long limit)
+        {
+            Address holeStart = memoryArray.findNext(densePrefix, false);
+            if (holeStart < 0 || holeStart == allocatedBytes) 
+            {
+                // Everything allocated is below the hole. Policies that do not merge every
+                // free neighbour can still have the free space split, so make it one block.
+                densePrefix = holeStart < 0 ? totalMemory : holeStart;
+                if (placement->freeBlockCount() > 1) 
+                {
+                    placement->reset(holeStart, totalMemory - holeStart);
+                }
+                return 0;
+            }
+            densePrefix = holeStart;
+            auto blockIt = blockAtAddress.at(memoryArray.findNext(holeStart == sweepHole ? sweepEnd : holeStart, true));
+            auto& block = *blockIt;
+            if (limit > 0 && block.size > limit) 
+            {
+                return 0;
+            }
+            Address source = block.start;
+            placement->release(source, block.size);
+            placement->claim(holeStart, block.size);
+            memoryArray.setRange(holeStart, block.size);
+            Address clearStart = max(source, holeStart + block.size);
+            memoryArray.clearRange(clearStart, source + block.size - clearStart);
+            movePayload(holeStart, source, block.size);
+
+            markChanged(source);
+            blockAtAddress.erase(source);
+            block.start = holeStart;
+            markChanged(holeStart);
+            blockAtAddress[holeStart] = blockIt;
+            handleTable[block.handle] = holeStart;
+            densePrefix = holeStart + block.size;
+            sweepHole = densePrefix;
+            sweepEnd = source + block.size;
+            statistics.bytesMoved += block.size;
+            statistics.blocksMoved++;
+            return block.size;
+        }
+
+        // Records a new block at [startAddress, startAddress + size), already taken from the placement policy, and binds the symbol to it
+        void addBlock(Address startAddress, Address size, int symbol, int slab = -1)
+        {
+            markChanged(startAddress);
+            if (startAddress < sweepEnd) 
+            {
+                sweepHole = -1;
+            }
+            int handle;
+            if (freeHandles.empty()) 
+            {
+                handle = static_cast<int>(handleTable.size());
+                handleTable.push_back(startAddress);
+            }
+            else 
+            {
+                handle = freeHandles.back();
+                freeHandles.pop_back();
+                handleTable[handle] = startAddress;
+            }
+            Block newBlock = {startAddress, size, 1, {}, handle, slab};
+            allocatedBlocks.push_back(newBlock);
+            blockAtAddress[startAddress] = prev(allocatedBlocks.end());
+            allocatedBytes += size;
+
+            // Update memory array to mark as allocated
+            memoryArray.setRange(startAddress, size);
+
+            // Bind the variable to the block
+            bindVariable(prev(allocatedBlocks.end()), symbol);
+        }
+
+        // Forgets a block whose last variable is gone. The caller returns its range to the placement policy.
+        void removeBlock(BlockIterator blockIt)
+        {
+            Address startAddress = blockIt->start;
+
+            // Update memory array to mark as deallocated
+            memoryArray.clearRange(startAddress, blockIt->size);
+
+            allocatedBytes -= blockIt->size;
+            densePrefix = min(densePrefix, startAddress);
+            handleTable[blockIt->handle] = -1;
+            freeHandles.push_back(blockIt->handle);
+            blockAtAddress.erase(startAddress);
+            allocatedBlocks.erase(blockIt);
+        }
+
+        /***************************************************************
+        Function: dissolveSlabs
+        Use: Turns the blocks in slabs into ordinary blocks and gives the rest of the slabs
+        back to the placement policy.
+        Arguments: none
+        Returns: Nothing.
+        Notes: Compaction moves single blocks, which would break the slots of a slab, so it
+        dissolves the slabs first. Every gap between the blocks of a slab, the tails of their
+        slots and the free slots, is released. Later small allocations carve new slabs.
+        ***************************************************************/
+        void dissolveSlabs()
+        {
+            if (slabCache.reservedBytes() == 0) 
+            {
+                return;
+            }
+            for (const auto& slab : slabCache.allSlabs()) 
+            {
+                if (slab.bytes == 0) 
+                {
+                    continue;
+                }
+                Address cursor = slab.start;
+                for (uint64_t used = slab.used; used != 0; used &= used - 1) 
+                {
+                    Address slotStart = slab.start + countr_zero(used) * slab.slotSize;
+                    auto& block = *blockAtAddress.at(slotStart);
+                    block.slab = -1;
+                    if (slotStart > cursor) 
+                    {
+                        placement->release(cursor, slotStart - cursor);
+                    }
+                    cursor = slotStart + block.size;
+                }
+                if (cursor < slab.start + slab.bytes) 
+                {
+                    placement->release(cursor, slab.start + slab.bytes - cursor);
+                }
+                densePrefix = min(densePrefix, slab.start);
+            }
+            slabCache.clear();
+        }
+
+        // Hands the range of a removed block back to its slab or to the placement policy
+        void releaseRange(Address startAddress, Address size, int slab)
+        {
+            if (slab >= 0) 
+            {
+                slabCache.release(slab, startAddress, static_cast<int>(size), *placement);
+            }
+            else 
+            {
+                placement->release(startAddress, size);
+            }
+        }
+
+        // True if the symbol is an allocated variable
+        bool isBound(int symbol) const
+        {
+            return symbol >= 0 && symbol < static_cast<int>(variableBindings.size()) && variableBindings[symbol].slot >= 0;
+        }
+
+        // Adds a variable to the end of a block's variables
+        void bindVariable(BlockIterator blockIt, int symbol)
+        {
+            if (symbol >= static_cast<int>(variableBindings.size())) 
+            {
+                variableBindings.resize(symbols.capacity());
+            }
+            variableBindings[symbol] = {blockIt, static_cast<int>(blockIt->variables.size())};
+            blockIt->variables.push_back(symbol);
+        }
+
+        // Removes a variable from its block's variables in O(1), moving the last one into its slot, and releases its symbol
+        void unbindVariable(int symbol)
+        {
+            auto& variables = variableBindings[symbol].block->variables;
+            size_t slot = variableBindings[symbol].slot;
+            variables.swapRemove(slot);
+            if (slot < variables.size()) 
+            {
+                variableBindings[variables[slot]].slot = static_cast<int>(slot);
+            }
+            variableBindings[symbol] = {};
+            symbols.release(symbol);
+        }
+
+        // The text line and the JSON object print uses for an allocated block
+        void writeBlock(OutputSink & outputFile, const Block& block)
+        {
+            outputFile << "Start: " << block.start << ", Size: " << block.size << ", RefCount: " << block.refCount << ", Variables: ";
+            for (int variable : block.variables) {
+                outputFile << symbols.name(variable) << " ";
+            }
+            outputFile << "\n";
+        }
+
+        string blockJson(OutputSink & outputFile, const Block& block)
+        {
+            string json = "{\"start\":" + to_string(block.start) + ",\"size\":" + to_string(block.size)
+                          + ",\"refCount\":" + to_string(block.refCount) + ",\"variables\":[";
+            for (size_t i = 0; i < block.variables.size(); ++i) 
+            {
+                json += (i > 0 ? ",\"" : "\"") + outputFile.escape(symbols.name(block.variables[i])) + "\"";
+            }
+            return json + "]}";
+        }
+
+        /***************************************************************
+        Function: unfragmentParallel
+        Use: Does the work of unfragment on the worker pool.
+        Arguments: 1. movingBlocks: the blocks above the first hole, in any order.
+                   2. denseEnd: the start of the first hole.
+                   3. allocatedEnd: where the allocated memory ends after compaction.
+        Returns: The number of bytes and blocks moved.
+        Notes: The blocks are split into one contiguous part per worker and each step
+        runs on all parts at once:
+        1. Each part is sorted by start address, then the parts are merged pairwise.
+        2. A parallel prefix sum gives the new start addresses: every part sums its sizes,
+           the part sums are scanned, and every part fills in its own addresses.
+        3. The bitmap from the first hole to the end of the highest block is rewritten in
+           word aligned pieces, set below allocatedEnd and clear above it. An Occupancy
+           that cannot be changed from several threads, such as ExtentMap, is instead
+           updated here with one set and one clear, which costs as much as the
+           extents in the range.
+        4. In an arena, every part first copies aside the bytes of its source range that
+           later parts will write over, which is at most as much as the part slides down,
+           and then moves its payloads, taking those bytes from the copy.
+        5. The blocks and the handle table are updated by part.
+        blockAtAddress and the print delta tracking cannot take concurrent inserts, so they
+        are updated serially before step 5. The resulting layout is the same as the serial one.
+        ***************************************************************/
+        CompactionResult unfragmentParallel(vector<BlockIterator>& movingBlocks, Address denseEnd, Address allocatedEnd)
+        {
+            WorkerPool& pool = *workers;
+            int parts = pool.size();
+            size_t count = movingBlocks.size();
+            auto partBegin = [&](int part) { return count * part / parts; };
+            auto byStart = [](const auto& a, const auto& b) { return a->start < b->start; };
+
+            // 1. Sort every part, then merge neighbouring runs until one is left
+            pool.run([&](int part) { sort(movingBlocks.begin() + partBegin(part), movingBlocks.begin() + partBegin(part + 1), byStart); });
+            for (int width = 1; width < parts; width *= 2) 
+            {
+                pool.run([&](int part) 
+                {
+                    int left = part * 2 * width;
+                    if (left + width < parts) 
+                    {
+                        inplace_merge(movingBlocks.begin() + partBegin(left), movingBlocks.begin() + partBegin(left + width),
+                                      movingBlocks.begin() + partBegin(min(left + 2 * width, parts)), byStart);
+                    }
+                });
+            }
+
+            // 2. Prefix sum of the sizes: part sums, a scan over the parts, then the addresses
+            vector<Address> newStart(count), partBytes(parts + 1, 0);
+            pool.run([&](int part) 
+            {
+                Address bytes = 0;
+                for (size_t i = partBegin(part); i < partBegin(part + 1); ++i) 
+                {
+                    bytes += movingBlocks[i]->size;
+                }
+                partBytes[part + 1] = bytes;
+            });
+            partial_sum(partBytes.begin(), partBytes.end(), partBytes.begin());
+            pool.run([&](int part) 
+            {
+                Address address = denseEnd + partBytes[part];
+                for (size_t i = partBegin(part); i < partBegin(part + 1); ++i) 
+                {
+                    newStart[i] = address;
+                    address += movingBlocks[i]->size;
+                }
+            });
+
+            // 3. Bitmap: pieces start at multiples of 64, so no two workers share a word
+            Address oldEnd = movingBlocks.back()->start + movingBlocks.back()->size;
+            if constexpr (Occupancy::concurrentRanges) 
+            {
+                auto pieceBegin = [&](int part)
+                {
+                    if (part == parts) 
+                    {
+                        return oldEnd;
+                    }
+                    long long boundary = denseEnd + static_cast<long long>(oldEnd - denseEnd) * part / parts;
+                    return max(denseEnd, static_cast<Address>(boundary & ~63LL));
+                };
+                pool.run([&](int part) 
+                {
+                    Address first = pieceBegin(part), last = pieceBegin(part + 1);
+                    memoryArray.setRange(first, min(last, allocatedEnd) - first);
+                    memoryArray.clearRange(max(first, allocatedEnd), last - max(first, allocatedEnd));
+                });
+            }
+            else 
+            {
+                memoryArray.setRange(denseEnd, allocatedEnd - denseEnd);
+                memoryArray.clearRange(allocatedEnd, oldEnd - allocatedEnd);
+            }
+
+            // 4. Payloads: save what later parts overwrite, then move every part's blocks
+            if (!arena.empty()) 
+            {
+                vector<Address> savedStart(parts, 0), savedEnd(parts, 0);
+                vector<size_t> savedOffset(parts + 1, 0);
+                for (int part = 0; part < parts; ++part) 
+                {
+                    size_t first = partBegin(part), last = partBegin(part + 1);
+                    if (first < last) 
+                    {
+                        // Later parts only write to [end of this part's target, allocatedEnd)
+                        Address targetEnd = newStart[last - 1] + movingBlocks[last - 1]->size;
+                        Address sourceEnd = movingBlocks[last - 1]->start + movingBlocks[last - 1]->size;
+                        savedStart[part] = max(movingBlocks[first]->start, targetEnd);
+                        savedEnd[part] = max(savedStart[part], min(sourceEnd, allocatedEnd));
+                    }
+                    savedOffset[part + 1] = savedOffset[part] + (savedEnd[part] - savedStart[part]);
+                }
+                vector<char> saved(savedOffset[parts]);
+                pool.run([&](int part) 
+                {
+                    // saved may be empty, and memcpy must not get its null data even for 0 bytes
+                    if (savedEnd[part] > savedStart[part]) 
+                    {
+                        memcpy(saved.data() + savedOffset[part], arena.data() + savedStart[part], savedEnd[part] - savedStart[part]);
+                    }
+                });
+                pool.run([&](int part) 
+                {
+                    for (size_t i = partBegin(part); i < partBegin(part + 1); ++i) 
+                    {
+                        Address source = movingBlocks[i]->start, size = movingBlocks[i]->size, target = newStart[i];
+                        Address low = clamp(savedStart[part] - source, Address(0), size),
+                                high = clamp(savedEnd[part] - source, low, size);
+                        memmove(arena.data() + target, arena.data() + source, low);
+                        if (high > low) 
+                        {
+                            memcpy(arena.data() + target + low, saved.data() + savedOffset[part] + (source + low - savedStart[part]), high - low);
+                        }
+                        memmove(arena.data() + target + high, arena.data() + source + high, size - high);
+                    }
+                });
+            }
+
+            for (const auto& blockIt : movingBlocks) 
+            {
+                markChanged(blockIt->start);
+                blockAtAddress.erase(blockIt->start);
+            }
+            for (size_t i = 0; i < count; ++i) 
+            {
+                markChanged(newStart[i]);
+                blockAtAddress[newStart[i]] = movingBlocks[i];
+            }
+
+            // 5. Every part updates its own blocks and handles
+            pool.run([&](int part) 
+            {
+                for (size_t i = partBegin(part); i < partBegin(part + 1); ++i) 
+                {
+                    auto& block = *movingBlocks[i];
+                    block.start = newStart[i];
+                    handleTable[block.handle] = block.start;
+                }
+            });
+            return {allocatedEnd - denseEnd, static_cast<int>(count)};
+        }
+    public:
+        
+        /***************************************************************
+        Class Constructor: MemoryManager
+
+        Use: Initializes an instance of the MemoryManager class with
+        a specified size, creating an initial block of memory
+        and setting up the necessary data structures for memory
+        management.
+
+        Arguments: 1. size - an integer representing the total size of the
+                   memory managed by the MemoryManager.
+                   2. policy - the placement policy that decides where new blocks go,
+                   best fit if none is given.
+                   3. ownsArena - true to back the memory with a real buffer of size bytes,
+                   holding the payloads of the blocks.
+
+        Returns: Nothing.
+
+        Notes: The constructor initializes the totalMemory attribute the specified size 
+        and creates an initial FreeBlock covering the entire memory space. The memoryArray
+        bitmap is initialized to zeros, indicating that all memory is initially unallocated. This 
+        class is designed for managing dynamic memory allocation and deallocation, and it uses
+        a linked list to keep track of allocated memory blocks, while the free blocks are kept by the
+        placement policy. The initial free block covers the entire memory space, and as memory is
+        allocated and deallocated, these structures are updated accordingly.
+        ***************************************************************/
+
+        MemoryManager(Address size, unique_ptr<PlacementPolicy<Address>> policy = make_unique<BestFitPolicy<Address>>(), bool ownsArena = false)
+            : totalMemory(size), memoryArray(size), placement(std::move(policy)), arena(ownsArena ? size : 0) 
+        {
+            placement->reset(0, size);
+        }
+
+        const PlacementPolicy<Address>& placementPolicy() const { return *placement; }
+        Address allocatedMemory() const { return allocatedBytes; }
+        Address freeMemory() const { return totalMemory - allocatedBytes; }
+        const AllocatorStatistics& operationStatistics() const { return statistics; }
+        bool ownsArena() const { return !arena.empty(); }
+
+        // Serves allocations of up to size bytes from size-class slabs (see SlabCache), 0 for none
+        void setSlabMaxSize(int size)
+        {
+            dissolveSlabs();
+            slabCache.configure(size);
+        }
+        const SlabCache<Address>& slabs() const { return slabCache; }
+
+        // Compacts on this many threads, serially for 1 or less
+        void setCompactionThreads(int threads) { workers = threads > 1 ? make_unique<WorkerPool>(threads) : nullptr; }
+        int compactionThreads() const { return workers ? workers->size() : 1; }
+
+        // True if both managers hold the same blocks at the same addresses with the same payloads
+        bool sameLayout(const MemoryManager& other) const
+        {
+            return arena == other.arena && equal(allocatedBlocks.begin(), allocatedBlocks.end(), other.allocatedBlocks.begin(), other.allocatedBlocks.end(),
+                                                 [&](const Block& a, const Block& b)
+                                                 {
+                                                     return a.start == b.start && a.size == b.size && a.refCount == b.refCount
+                                                            && equal(a.variables.begin(), a.variables.end(), b.variables.begin(), b.variables.end(),
+                                                                     [&](int x, int y) { return symbols.name(x) == other.symbols.name(y); });
+                                                 });
+        }
+
+        /***************************************************************
+        Function: handleOf
+        Use: Gives the stable handle of the block a variable refers to.
+        Arguments: variableName - the variable.
+        Returns: The handle, or -1 if the variable is not allocated.
+        Notes: A handle stays the same when compaction moves its block and is
+        shared by every variable referring to the block. It becomes invalid when
+        the block is freed and may then be given to a later allocation.
+        ***************************************************************/
+        int handleOf(string_view variableName) const
+        {
+            int symbol = symbols.find(variableName);
+            return isBound(symbol) ? variableBindings[symbol].block->handle : -1;
+        }
+
+        // Start address of a handle's block, -1 if the handle is not in use
+        Address resolveHandle(int handle) const
+        {
+            return handle >= 0 && handle < static_cast<int>(handleTable.size()) ? handleTable[handle] : -1;
+        }
+
+        /***************************************************************
+        Function: writePayload
+        Use: Copies bytes into the payload of a block in the arena.
+        Arguments: 1. handle: the block's handle.
+                   2. offset: where in the block to start writing.
+                   3. data, length: the bytes to write.
+        Returns: false if there is no arena, the handle is not in use, or the
+        range does not lie inside the block.
+        ***************************************************************/
+        bool writePayload(int handle, Address offset, const void* data, Address length)
+        {
+            char* target = payloadRange(handle, offset, length);
+            if (target == nullptr) 
+            {
+                return false;
+            }
+            memcpy(target, data, length);
+            return true;
+        }
+
+        /***************************************************************
+        Function: readPayload
+        Use: Copies bytes out of the payload of a block in the arena.
+        Arguments: 1. handle: the block's handle.
+                   2. offset: where in the block to start reading.
+                   3. data, length: where to put the bytes and how many to read.
+        Returns: false if there is no arena, the handle is not in use, or the
+        range does not lie inside the block.
+        ***************************************************************/
+        bool readPayload(int handle, Address offset, void* data, Address length)
+        {
+            const char* source = payloadRange(handle, offset, length);
+            if (source == nullptr) 
+            {
+                return false;
+            }
+            memcpy(data, source, length);
+            return true;
+        }
+
+
+        /***************************************************************
+        Function: allocateMemory
+
+        Use: Allocates a block of memory for a given variable.
+
+        Arguments:
+        1. size: an integer representing the size of the memory block to be allocated. A size larger
+                 than the whole memory fails with -2.
+        2. variableName: a string_view representing the name of the 
+                         variable for which memory is to be allocated.
+
+        Returns:
+        -1: If the variable with the given name already has memory allocated.
+        -2: If there is not enough memory available for the requested allocation.
+        startAddress: If memory is successfully allocated, returns the starting address of the allocated block.
+
+        Notes:
+        The placement policy chooses the free block to carve the request from. With the default best fit
+        policy, if multiple blocks have sufficient size, it allocates the smallest block of memory that is
+        sufficient to accommodate the memory request, and ties between equally sized blocks go to the lowest address.
+        The policy may round the size up (the buddy policy does), and the rounded size is what the block records.
+        If a suitable block is found, it allocates memory, updates the memory array,
+        and maintains a mapping of the variable name to the allocated memory's starting address.
+        ***************************************************************/
+
+        // int allocateMemory(int size, const string& variableName) 
+        // {
+        //     if (variableToAddress.find(variableName) != variableToAddress.end()) 
+        //     {
+        //         return -1; 
+        //     }
+        //     for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) 
+        //     {
+        //         if (it->size >= size) 
+        //         {
+        //             int startAddress = it->start;
+        //             MemoryBlock newBlock = {startAddress, size, 1, {variableName}};
+        //             allocatedBlocks.push_back(newBlock);
+
+        //             // Update memory array to mark as allocated
+        //             for (int i = startAddress; i < startAddress + size; ++i) 
+        //             {
+        //                 memoryArray[i] = 1;
+        //             }
+
+        //             // Update free block list
+        //             it->start += size;
+        //             it->size -= size;
+        //             if (it->size == 0) 
+        //             {
+        //                 freeBlocks.erase(it);
+        //             }
+
+        //             // Update variable to address mapping
+        //             variableToAddress[variableName] = startAddress;
+
+        //             return startAddress;
+        //         }
+        //     }
+
+        //     return -2; // Not enough memory
+        // }
+        Address allocateMemory(long long size, string_view variableName, OutputSink &outputFile)
+        {
+            OperationTimer timer(statistics.allocate);
+            if (variableName.empty() || isdigit(variableName[0])) 
+            {
+                reportInvalidAllocation(size, variableName, outputFile);
+                return timer.fail(-3);
+            }
+            int symbol = symbols.intern(variableName);
+            if (isBound(symbol)) 
+            {
+                return timer.fail(-1); // Variable already exists
+            }
+            if (size < 1)
+            {
+                symbols.release(symbol);
+                reportInvalidAllocation(size, variableName, outputFile);
+                return timer.fail(-3);
+            }
+            if (size > totalMemory) 
+            {
+                symbols.release(symbol);
+                return timer.fail(-2);
+            }
+
+            Address blockSize = static_cast<Address>(size);
+            int slab = -1;
+            Address startAddress = slabCache.serves(blockSize) ? slabCache.allocate(static_cast<int>(blockSize), *placement, slab) : -1;
+            if (slab < 0) 
+            {
+                blockSize = placement->blockSize(blockSize);
+                startAddress = placement->allocate(blockSize);
+                if (startAddress < 0 && slabCache.releaseEmpty(*placement)) 
+                {
+                    startAddress = placement->allocate(blockSize);
+                }
+            }
+
+            // Check if a suitable free block is found
+            if (startAddress >= 0) 
+            {
+                addBlock(startAddress, blockSize, symbol, slab);
+                return startAddress; // Return the start address of the allocated memory block
+            }
+
+            symbols.release(symbol);
+
+            return timer.fail(-2); // Not enough memory
+        }
+
+        
+        /***************************************************************
+        Function: deallocateMemory
+
+        Use:       Deallocates memory for a given variable name.
+
+        Arguments: 1. variableName: a string_view, representing the name of the variable to deallocate.
+                   2. outputFile: the output sink, where error or informational messages are written.
+
+        Returns:   1, if memory deallocation is successful, otherwise just writes the case in the output file itself.
+
+        Notes:     This function looks up the variable's symbol and its binding. 
+                   If found, the block is looked up by its start address in blockAtAddress, and it decreases the reference count of the associated memory block. If the 
+                   reference count becomes zero, the memory is marked as deallocated in the memory array, 
+                   and the block is handed back to the placement policy, which merges it with
+                   neighbouring free space according to its own rules.
+                   If the variable is not found, an error message is written to the output stream. The function 
+                   returns 1 on success.
+        ***************************************************************/
+
+        
+        int deallocateMemory(string_view variableName, OutputSink &outputFile)
+        {
+            OperationTimer timer(statistics.free);
+            int symbol = symbols.find(variableName);
+            if (isBound(symbol)) 
+            {
+                auto blockIt = variableBindings[symbol].block;
+                Address startAddress = blockIt->start;
+                markChanged(startAddress);
+                // Remove the variable from the block and release its symbol
+                unbindVariable(symbol);
+                if (--(blockIt->refCount) == 0) 
+                {
+                    Address size = blockIt->size;
+                    int slab = blockIt->slab;
+                    removeBlock(blockIt);
+
+                    // Hand the block back to its slab or the free space
+                    releaseRange(startAddress, size, slab);
+                }
+                else
+                {
+                    reportUnfinishedFree(variableName, blockIt->refCount, outputFile);
+                    return -1;
+                }
+            }
+            else
+            {
+                reportUnfinishedFree(variableName, -1, outputFile);
+                return timer.fail(-1);
+            }
+            return 1;
+        }
+
+        /***************************************************************
+        Function: allocateBatch
+
+        Use: Allocates a run of blocks for a batch of variables at once.
+
+        Arguments: 1. requests: the size and variable name of each allocation.
+                   2. results: receives, for each request, its start address, or
+                   -1 if the variable is already allocated (also by an earlier
+                   request of the batch), -2 if nothing fits and -3 if the
+                   name or size is invalid.
+
+        Returns: Nothing. Nothing is written to an output; see reportInvalidAllocation.
+
+        Notes: The requests are checked in order, and the valid ones are then
+        handed to the placement policy together, which places them one after
+        another in a single free block when one can hold them all. The blocks
+        of a batch that is set up together are then adjacent, and the free
+        space is searched and split once instead of once per block. Requests that
+        the slab cache serves take a slot in a slab instead.
+        ***************************************************************/
+        void allocateBatch(const vector<AllocationRequest>& requests, vector<Address>& results)
+        {
+            OperationTimer timer(statistics.allocateBatch);
+            results.assign(requests.size(), -3);
+            vector<int> placedRequests,
+                        placedSymbols;
+            vector<Address> sizes,
+                            addresses;
+            unordered_set<int> batchSymbols;
+            for (size_t i = 0; i < requests.size(); ++i) 
+            {
+                string_view variableName = requests[i].variableName;
+                if (variableName.empty() || isdigit(variableName[0])) 
+                {
+                    continue;
+                }
+                int symbol = symbols.intern(variableName);
+                if (isBound(symbol) || batchSymbols.count(symbol)) 
+                {
+                    results[i] = -1;
+                    continue;
+                }
+                if (requests[i].size < 1) 
+                {
+                    symbols.release(symbol);
+                    continue;
+                }
+                if (requests[i].size > totalMemory) 
+                {
+                    symbols.release(symbol);
+                    results[i] = -2;
+                    continue;
+                }
+                batchSymbols.insert(symbol);
+                Address size = static_cast<Address>(requests[i].size);
+                int slab = -1;
+                Address slotStart = slabCache.serves(size) ? slabCache.allocate(static_cast<int>(size), *placement, slab) : -1;
+                if (slotStart >= 0) 
+                {
+                    addBlock(slotStart, size, symbol, slab);
+                    results[i] = slotStart;
+                    continue;
+                }
+                placedRequests.push_back(static_cast<int>(i));
+                placedSymbols.push_back(symbol);
+                sizes.push_back(placement->blockSize(size));
+            }
+
+            placement->allocateBatch(sizes, addresses);
+            for (size_t j = 0; j < placedRequests.size(); ++j) 
+            {
+                results[placedRequests[j]] = addresses[j] >= 0 ? addresses[j] : -2;
+                if (addresses[j] >= 0) 
+                {
+                    addBlock(addresses[j], sizes[j], placedSymbols[j]);
+                }
+                else 
+                {
+                    symbols.release(placedSymbols[j]);
+                }
+            }
+            if (any_of(results.begin(), results.end(), [](Address result) { return result < 0; })) 
+            {
+                timer.fail(0);
+            }
+        }
+
+        /***************************************************************
+        Function: freeBatch
+
+        Use: Deallocates a batch of variables at once.
+
+        Arguments: 1. variableNames: the variables to free, in order.
+                   2. results: receives, for each variable, 0 if its block was freed,
+                   the block's remaining reference count if other variables still
+                   refer to it, or -1 if the variable is not allocated.
+
+        Returns: Nothing. Nothing is written to an output; see reportUnfinishedFree.
+
+        Notes: The blocks whose reference count drops to zero are collected,
+        sorted by address and returned to the placement policy in one pass,
+        which merges every run of them with the free space on both sides.
+        A single deallocateMemory only merges with the free block before it
+        under the fit policies, so freeing a whole structure as a batch
+        leaves fewer, larger holes.
+        ***************************************************************/
+        void freeBatch(const vector<string_view>& variableNames, vector<int>& results)
+        {
+            OperationTimer timer(statistics.freeBatch);
+            results.assign(variableNames.size(), -1);
+            vector<FreeBlock<Address>> released;
+            for (size_t i = 0; i < variableNames.size(); ++i) 
+            {
+                int symbol = symbols.find(variableNames[i]);
+                if (!isBound(symbol)) 
+                {
+                    continue;
+                }
+                auto blockIt = variableBindings[symbol].block;
+                markChanged(blockIt->start);
+                unbindVariable(symbol);
+                results[i] = --(blockIt->refCount);
+                if (blockIt->refCount == 0 && blockIt->slab >= 0) 
+                {
+                    Address start = blockIt->start;
+                    int size = static_cast<int>(blockIt->size),
+                        slab = blockIt->slab;
+                    removeBlock(blockIt);
+                    slabCache.release(slab, start, size, *placement);
+                }
+                else if (blockIt->refCount == 0) 
+                {
+                    released.push_back({blockIt->start, blockIt->size});
+                    removeBlock(blockIt);
+                }
+            }
+            sort(released.begin(), released.end(), [](const FreeBlock<Address>& a, const FreeBlock<Address>& b) { return a.start < b.start; });
+            placement->releaseBatch(released);
+            if (find(results.begin(), results.end(), -1) != results.end()) 
+            {
+                timer.fail(0);
+            }
+        }
+
+        // Writes why an allocation was refused as invalid (allocateMemory's -3)
+        static void reportInvalidAllocation(long long size, string_view variableName, OutputSink& outputFile)
+        {
+            if (variableName.empty()) 
+            {
+                outputFile.message(OutputSink::Errors) << "Variable name cannot be empty. " << variableName << "\n";
+            }
+            else if (isdigit(variableName[0])) 
+            {
+                outputFile.message(OutputSink::Errors) << "Variable name cannot start with a digit. " << variableName << "\n";
+            }
+            else 
+            {
+                outputFile.message(OutputSink::Errors) << "Allocation size must be a natural number. " << size << "\n";
+            }
+        }
+
+        // Writes why a free did not free a block: refCount is what other variables still hold, or -1 if the variable was not allocated
+        static void reportUnfinishedFree(string_view variableName, int refCount, OutputSink& outputFile)
+        {
+            if (refCount < 0) 
+            {
+                outputFile.message(OutputSink::Errors) << "Error: Variable " << variableName << " is not allocated.\n";
+            }
+            else 
+            {
+                outputFile.message(OutputSink::Full).field("name", variableName).field("refCount", refCount)
+                          << "Reference count decreased by one for the block referred by " << variableName << "\n";
+            }
+        }
+
+        /***************************************************************
+        Function: referenceMemory
+
+        Use:        Associates var1 with the same block of memory as var2,
+                    updating the reference count and memory mapping.
+
+        Arguments: 1. var1: a string_view representing
+                    the variable to be associated with var2.
+                2. var2: a string_view representing
+                    the variable whose memory block will be referenced.
+
+        Returns:   -1 if var1 is already an allocated variable
+                    (indicating allocation failure due to duplicate variable).
+                    true if var1 is successfully associated with the same memory
+                    block as var2, and the reference count and memory mapping
+                    are updated accordingly.
+                    false if there is no block associated with var2.
+
+        Notes:      This function checks if var1 is already an allocated
+                    variable, and returns -1 in such cases. It then
+                    looks up the block associated with var2 in blockAtAddress
+                    by its start address. If found, var1 is added to the variables list of
+                    the same block, the reference count is increased, and var1 is
+                    bound to the block. If no block is found
+                    for var2, the function returns false.
+        ***************************************************************/
+        int referenceMemory(string_view var1, string_view var2)
+        {
+            OperationTimer timer(statistics.reference);
+            // Check if var1 already exists
+            int var1Symbol = symbols.intern(var1);
+            if (isBound(var1Symbol)) 
+            {
+                return timer.fail(-1); // var1 already exists
+            }
+
+            // Find the block associated with var2
+            int var2Symbol = symbols.find(var2);
+            if (isBound(var2Symbol)) 
+            {
+                auto blockIt = variableBindings[var2Symbol].block;
+                markChanged(blockIt->start);
+                // Add var1 to the variables of the same block
+                bindVariable(blockIt, var1Symbol);
+                // Increase the reference count
+                blockIt->refCount++;
+
+                return true; // Reference successful
+            }
+
+            symbols.release(var1Symbol);
+            return timer.fail(false); // No block associated with var2
+        }
+
+        /***************************************************************
+        Function: unfragment
+        Use: Performs memory compaction by sliding allocated blocks towards address 0 and updating related data structures.
+        Arguments: totalMemorySize - an integer representing the total size of the memory (in bytes).
+        Returns: A CompactionResult holding the number of bytes and blocks that were moved.
+        Notes:
+        Slabs are dissolved first (see dissolveSlabs), so their blocks move like any other.
+        Everything below the lowest free block is already dense and is left alone. The blocks above it are
+        visited in address order and each one gets a new start address from a running prefix sum of the sizes
+        before it, so blocks keep their relative order and only slide down over the holes.
+        Only the bitmap bits that change are touched: the holes below the new end of allocated memory are set,
+        and the old block bytes above it are cleared.
+        The placement policy's free space is replaced by a single free block covering the remaining memory, and the
+        blockAtAddress is updated for the moved blocks only. Variables are bound to their
+        blocks rather than to addresses, so they need no update.
+        The cost grows with the number of blocks and holes, not with the memory size.
+        When the manager owns an arena the payloads are moved as well, with one memmove per
+        run of blocks that were adjacent, and the handle table is patched so handles keep
+        resolving to their blocks.
+        With more than one compaction thread, compactions that move many blocks or, in an
+        arena, many bytes run on the worker pool (see unfragmentParallel) and give the same
+        layout. Smaller ones stay serial.
+        ***************************************************************/
+        CompactionResult unfragment(Address totalMemorySize) 
+        {
+            OperationTimer timer(statistics.unfragment);
+            CompactionResult result = {0, 0};
+            dissolveSlabs();
+            vector<FreeBlock<Address>> freeBlocks = placement->freeBlockList();
+            if (freeBlocks.empty()) 
+            {
+                return result; // No holes, memory is already dense
+            }
+
+            // Everything before the first hole stays where it is
+            Address denseEnd = freeBlocks.front().start;
+            vector<BlockIterator> movingBlocks;
+            Address currentAddress = denseEnd;
+            for (auto blockIt = allocatedBlocks.begin(); blockIt != allocatedBlocks.end(); ++blockIt) 
+            {
+                if (blockIt->start > denseEnd) 
+                {
+                    movingBlocks.push_back(blockIt);
+                    currentAddress += blockIt->size;
+                }
+            }
+            // The sum of the block sizes gives the new end of allocated memory
+            Address allocatedEnd = currentAddress;
+
+            if (workers && (movingBlocks.size() >= parallelCompactionBlocks || (!arena.empty() && allocatedEnd - denseEnd >= parallelCompactionBytes))) 
+            {
+                result = unfragmentParallel(movingBlocks, denseEnd, allocatedEnd);
+                placement->reset(allocatedEnd, totalMemorySize - allocatedEnd);
+                densePrefix = allocatedEnd;
+                sweepHole = -1;
+                statistics.bytesMoved += result.bytesMoved;
+                statistics.blocksMoved += result.blocksMoved;
+                return result;
+            }
+            sort(movingBlocks.begin(), movingBlocks.end(),
+                 [](const auto& a, const auto& b) { return a->start < b->start; });
+
+            // Holes below allocatedEnd become allocated, block bytes above it become free
+            for (const auto& freeBlock : freeBlocks) 
+            {
+                if (freeBlock.start >= allocatedEnd) 
+                {
+                    break;
+                }
+                memoryArray.setRange(freeBlock.start, min(freeBlock.size, allocatedEnd - freeBlock.start));
+            }
+            for (const auto& blockIt : movingBlocks) 
+            {
+                Address blockEnd = blockIt->start + blockIt->size;
+                if (blockEnd > allocatedEnd) 
+                {
+                    Address clearStart = max(blockIt->start, allocatedEnd);
+                    memoryArray.clearRange(clearStart, blockEnd - clearStart);
+                }
+            }
+
+            // Re-address the allocated blocks in address order. In an arena the payloads of
+            // blocks that were adjacent before the move are moved together with one memmove.
+            currentAddress = denseEnd;
+            Address runSource = 0, runTarget = 0, runLength = 0;
+            for (const auto& blockIt : movingBlocks) 
+            {
+                auto& block = *blockIt;
+                if (block.start != currentAddress) 
+                {
+                    if (runSource + runLength == block.start && runTarget + runLength == currentAddress) 
+                    {
+                        runLength += block.size;
+                    }
+                    else 
+                    {
+                        movePayload(runTarget, runSource, runLength);
+                        runSource = block.start;
+                        runTarget = currentAddress;
+                        runLength = block.size;
+                    }
+                    markChanged(block.start);
+                    blockAtAddress.erase(block.start);
+                    block.start = currentAddress;
+                    markChanged(block.start);
+                    blockAtAddress[block.start] = blockIt;
+                    handleTable[block.handle] = block.start;
+                    result.bytesMoved += block.size;
+                    result.blocksMoved++;
+                }
+                currentAddress += block.size;
+            }
+            movePayload(runTarget, runSource, runLength);
+
+            // Replace the free space with the remaining memory as a single free block
+            placement->reset(currentAddress, totalMemorySize - currentAddress);
+            densePrefix = currentAddress;
+            sweepHole = -1;
+            statistics.bytesMoved += result.bytesMoved;
+            statistics.blocksMoved += result.blocksMoved;
+            return result;
+        }
+        
+        /***************************************************************
+        Function: compactStep
+        Use: Does one bounded part of a compaction, for incremental compaction between transactions.
+        Arguments: budget - the most bytes, blocks and time the step may spend, 0 meaning no limit.
+        Returns: The number of bytes and blocks that were moved.
+        Notes: Blocks are moved down into the lowest hole one at a time, in address order (see
+        moveLowestBlock), until the memory is dense or the next block would go over a budget.
+        The first block is always moved, so every step makes progress, and a step costs at most
+        the budget plus one block. Steps can be interleaved with any other operation, and
+        running them until nothing moves gives the same layout as unfragment.
+        ***************************************************************/
+        CompactionResult compactStep(const CompactionBudget& budget)
+        {
+            OperationTimer timer(statistics.compactStep);
+            CompactionResult result = {0, 0};
+            dissolveSlabs();
+            auto stepStart = chrono::steady_clock::now();
+            while (result.blocksMoved == 0
+                   || ((budget.bytes == 0 || result.bytesMoved < budget.bytes) && (budget.blocks == 0 || result.blocksMoved < budget.blocks)
+                       && (budget.time.count() == 0 || chrono::steady_clock::now() - stepStart < budget.time))) 
+            {
+                Address moved = moveLowestBlock(result.blocksMoved == 0 || budget.bytes == 0 ? 0 : budget.bytes - result.bytesMoved);
+                if (moved == 0) 
+                {
+                    break;
+                }
+                result.bytesMoved += moved;
+                result.blocksMoved++;
+            }
+            return result;
+        }
+
+        /***************************************************************
+        Function: compactToFit
+        Use: Compacts only until a block for a failed allocation fits.
+        Arguments: 1. size - the requested size.
+                   2. byteBudget - the most bytes to move, 0 for no limit.
+        Returns: The number of bytes and blocks that were moved.
+        Notes: Blocks are moved lowest first as in compactStep, which grows the free space at
+        the top, and the pass stops as soon as the placement policy's largest free block
+        can hold the request, the memory is dense, or the next block would go over the budget.
+        ***************************************************************/
+        CompactionResult compactToFit(Address size, long long byteBudget)
+        {
+            OperationTimer timer(statistics.compactToFit);
+            CompactionResult result = {0, 0};
+            dissolveSlabs();
+            Address needed = placement->blockSize(size);
+            while (placement->largestFreeBlock() < needed && (byteBudget == 0 || result.bytesMoved < byteBudget)) 
+            {
+                Address moved = moveLowestBlock(byteBudget == 0 ? 0 : byteBudget - result.bytesMoved);
+                if (moved == 0) 
+                {
+                    break;
+                }
+                result.bytesMoved += moved;
+                result.blocksMoved++;
+            }
+            return result;
+        }
+
+        /***************************************************************
+        Function: verifySlabs
+        Use: Checks that the slab cache agrees with the blocks and the free space.
+        Arguments: 1. freeBlocks - the placement policy's free blocks, in address order.
+                   2. outputFile - the output sink where any mismatch is reported.
+        Returns: true if every used slot holds a block of its slab, every block in a slab is
+        in a used slot, the bitmap of each slab counts exactly its blocks, and no free block
+        overlaps a slab.
+        ***************************************************************/
+        bool verifySlabs(const vector<FreeBlock<Address>>& freeBlocks, OutputSink & outputFile)
+        {
+            bool consistent = true;
+            long long usedSlots = 0;
+            vector<pair<Address, Address>> slabRanges; // (start, end)
+            const auto& slabs = slabCache.allSlabs();
+            for (int id = 0; id < static_cast<int>(slabs.size()); ++id) 
+            {
+                const auto& slab = slabs[id];
+                if (slab.bytes == 0) 
+                {
+                    continue;
+                }
+                slabRanges.push_back({slab.start, slab.start + slab.bytes});
+                Address heldBytes = 0;
+                for (uint64_t used = slab.used; used != 0; used &= used - 1) 
+                {
+                    Address slotStart = slab.start + countr_zero(used) * slab.slotSize;
+                    auto tableIt = blockAtAddress.find(slotStart);
+                    if (tableIt == blockAtAddress.end() || tableIt->second->slab != id || tableIt->second->size > slab.slotSize) 
+                    {
+                        outputFile.message(OutputSink::Errors) << "Check: used slot at " << slotStart << " does not hold a block of its slab.\n";
+                        consistent = false;
+                        continue;
+                    }
+                    heldBytes += tableIt->second->size;
+                    usedSlots++;
+                }
+                if (memoryArray.countRange(slab.start, slab.bytes) != heldBytes) 
+                {
+                    outputFile.message(OutputSink::Errors) << "Check: slab at " << slab.start << " has bytes marked as allocated outside its blocks.\n";
+                    consistent = false;
+                }
+            }
+            long long blocksInSlabs = count_if(allocatedBlocks.begin(), allocatedBlocks.end(), [](const Block& block) { return block.slab >= 0; });
+            if (blocksInSlabs != usedSlots) 
+            {
+                outputFile.message(OutputSink::Errors) << "Check: " << blocksInSlabs << " blocks are in slabs but " << usedSlots << " slots are used.\n";
+                consistent = false;
+            }
+            sort(slabRanges.begin(), slabRanges.end());
+            for (const auto& freeBlock : freeBlocks) 
+            {
+                auto slabIt = lower_bound(slabRanges.begin(), slabRanges.end(), make_pair(freeBlock.start + freeBlock.size, numeric_limits<Address>::min()));
+                if (slabIt != slabRanges.begin() && prev(slabIt)->second > freeBlock.start) 
+                {
+                    outputFile.message(OutputSink::Errors) << "Check: free block at " << freeBlock.start << " overlaps a slab.\n";
+                    consistent = false;
+                }
+            }
+            return consistent;
+        }
+
+        /***************************************************************
+        Function: verifyMemoryState
+        Use: Checks that the memoryArray bitmap agrees with the allocated and free block lists.
+        Arguments: outputFile - the output sink where any mismatch is reported.
+        Returns: true if the bitmap and the block lists agree, false otherwise.
+        Notes: Every check is a popcount over the bitmap words: each allocated block must be
+        fully set, each free block fully clear, and the total number of set bits must equal
+        the allocated bytes. The first free byte found in the bitmap must also be the start
+        of the lowest free block, unless slabs hold free slots below it. The slabs are
+        checked by verifySlabs. With an ExtentMap the same checks walk the extents instead.
+        ***************************************************************/
+        bool verifyMemoryState(OutputSink & outputFile)
+        {
+            bool consistent = true;
+            Address totalallocated = 0;
+            for (const auto& block : allocatedBlocks)
+            {
+                if (memoryArray.countRange(block.start, block.size) != block.size)
+                {
+                    outputFile.message(OutputSink::Errors) << "Check: block at " << block.start << " is not fully marked as allocated.\n";
+                    consistent = false;
+                }
+                totalallocated += block.size;
+            }
+            vector<FreeBlock<Address>> freeBlocks = placement->freeBlockList();
+            for (const auto& freeBlock : freeBlocks)
+            {
+                if (memoryArray.countRange(freeBlock.start, freeBlock.size) != 0)
+                {
+                    outputFile.message(OutputSink::Errors) << "Check: free block at " << freeBlock.start << " has bytes marked as allocated.\n";
+                    consistent = false;
+                }
+            }
+            if (memoryArray.count() != totalallocated)
+            {
+                outputFile.message(OutputSink::Errors) << "Check: " << memoryArray.count() << " bytes marked as allocated but blocks hold " << totalallocated << " bytes.\n";
+                consistent = false;
+            }
+            Address firstFree = freeBlocks.empty() ? -1 : freeBlocks.front().start;
+            if (slabCache.reservedBytes() == 0 && memoryArray.findZeroRun(1) != firstFree)
+            {
+                outputFile.message(OutputSink::Errors) << "Check: first free byte is " << memoryArray.findZeroRun(1) << " but the lowest free block starts at " << firstFree << ".\n";
+                consistent = false;
+            }
+            consistent = verifySlabs(freeBlocks, outputFile) && consistent;
+            if (consistent)
+            {
+                outputFile.message(OutputSink::Summary) << "Check: memory state is consistent.\n";
+            }
+            return consistent;
+        }
+
+        /***************************************************************
+        Function: printMemoryState
+        Use: Prints the current state of memory, including details
+        about allocated and free blocks.
+        Arguments: outputFile - the output sink (modified by printMemoryState).
+        The function assumes that the sink is open.
+        Returns: nothing
+        Notes: This function iterates over the lists of allocated and free blocks
+        and prints their details to the specified output sink, followed by the
+        total memory allocated and total memory free, which are kept up to date
+        by the other operations. In JSON-lines mode the same information is
+        written as one record with block arrays. Once print delta is in use, a full
+        print also starts a new delta. With the slab cache enabled the slabs are
+        listed after the free blocks; the blocks in them are listed with the
+        other allocated blocks, and their unused space counts as free.
+        ***************************************************************/
+        void printMemoryState(OutputSink & outputFile ) 
+        {
+            if (outputFile.is_open()) 
+            {
+                changedAddresses.clear();
+            if (outputFile.json()) 
+            {
+                // One record with the blocks as JSON arrays instead of the text listing
+                string allocatedJson = "[", freeJson = "[";
+                for (const auto& block : allocatedBlocks) 
+                {
+                    allocatedJson += (allocatedJson.size() > 1 ? "," : "") + blockJson(outputFile, block);
+                }
+                for (const auto& block : placement->freeBlockList()) 
+                {
+                    freeJson += (freeJson.size() > 1 ? ",{\"start\":" : "{\"start\":") + to_string(block.start) + ",\"size\":" + to_string(block.size) + "}";
+                }
+                outputFile.message(OutputSink::Summary).rawField("allocatedBlocks", allocatedJson + "]").rawField("freeBlocks", freeJson + "]");
+                if (slabCache.enabled()) 
+                {
+                    string slabsJson = "[";
+                    for (const auto& slab : slabCache.allSlabs()) 
+                    {
+                        if (slab.bytes > 0) 
+                        {
+                            slabsJson += (slabsJson.size() > 1 ? ",{\"start\":" : "{\"start\":") + to_string(slab.start) + ",\"size\":" + to_string(slab.bytes)
+                                         + ",\"slotSize\":" + to_string(slab.slotSize) + ",\"usedSlots\":" + to_string(popcount(slab.used)) + "}";
+                        }
+                    }
+                    outputFile.rawField("slabs", slabsJson + "]");
+                }
+                outputFile.field("totalAllocated", allocatedBytes).field("totalFree", freeMemory());
+                return;
+            }
+            outputFile.message(OutputSink::Summary);
+            outputFile << "\n";
+            outputFile << "Allocated Blocks:\n";
+            for (const auto& block : allocatedBlocks) 
+            {
+                writeBlock(outputFile, block);
+            }
+            outputFile << "Free Blocks:\n";
+            for (const auto& block : placement->freeBlockList()) 
+            {
+                outputFile << "Start: " << block.start << ", Size: " << block.size << "\n";
+            }
+            if (slabCache.enabled()) 
+            {
+                // Slabs are neither free blocks nor allocated blocks, so they get their own list
+                outputFile << "Slabs:\n";
+                for (const auto& slab : slabCache.allSlabs()) 
+                {
+                    if (slab.bytes > 0) 
+                    {
+                        outputFile << "Start: " << slab.start << ", Size: " << slab.bytes << ", Slot Size: " << slab.slotSize
+                                   << ", Used Slots: " << popcount(slab.used) << "\n";
+                    }
+                }
+            }
+            outputFile << "Total Memory Allocated: " << allocatedBytes << " bytes\n";
+            outputFile << "Total Memory Free: " << freeMemory() << " bytes\n\n";
+            } 
+            else 
+            {
+                // If unable to open the file, print to standard error
+                cerr << "Error opening output file.\n";
+            }
+        }
+
+        /***************************************************************
+        Function: printMemorySummary
+        Use: Prints the memory totals without listing any blocks.
+        Arguments: outputFile - the output sink to write to.
+        Returns: nothing
+        Notes: Prints the number of allocated blocks, the bytes allocated and free, the
+        number of holes, the largest free block and the fragmentation,
+        1 - largest free block / free memory, as a percentage. All of these are kept up
+        to date by the other operations and the placement policy, so this does not walk
+        the block lists. It does not start a new delta.
+        ***************************************************************/
+        void printMemorySummary(OutputSink & outputFile)
+        {
+            Address largestFreeBlock = placement->largestFreeBlock();
+            double fragmentation = freeMemory() == 0 ? 0 : round(1000.0 - 1000.0 * largestFreeBlock / freeMemory()) / 10;
+            char digits[32];
+            string fragmentationText(digits, to_chars(begin(digits), end(digits), fragmentation).ptr);
+            outputFile.message(OutputSink::Summary).field("blocks", static_cast<long long>(allocatedBlocks.size()))
+                      .field("totalAllocated", allocatedBytes).field("totalFree", freeMemory()).field("holes", placement->freeBlockCount())
+                      .field("largestFreeBlock", largestFreeBlock).rawField("fragmentationPercent", fragmentationText)
+                      << "Summary: " << allocatedBlocks.size() << " blocks, " << allocatedBytes << " bytes allocated, " << freeMemory()
+                      << " bytes free in " << placement->freeBlockCount() << " holes, largest free block " << largestFreeBlock
+                      << " bytes, fragmentation " << fragmentationText << "%\n\n";
+        }
+
+        /***************************************************************
+        Function: printMemoryDelta
+        Use: Prints only the allocated blocks that changed since the previous
+        print or print delta, followed by the totals.
+        Arguments: outputFile - the output sink to write to.
+        Returns: nothing
+        Notes: Changes are tracked by start address from the first print delta on,
+        so the first one lists every allocated block. A block is listed if it was
+        allocated, referenced, partly freed or moved by compaction, and an address
+        that held a block at the previous print but holds none now is listed as
+        freed. The cost is proportional to the number of changed addresses.
+        ***************************************************************/
+        void printMemoryDelta(OutputSink & outputFile)
+        {
+            vector<Address> changed;
+            if (trackChanges) 
+            {
+                changed.reserve(changedAddresses.size());
+                for (const auto& [start, wasAllocated] : changedAddresses) 
+                {
+                    if (wasAllocated || blockAtAddress.count(start) > 0) 
+                    {
+                        changed.push_back(start);
+                    }
+                }
+            }
+            else 
+            {
+                for (const auto& [start, blockIt] : blockAtAddress) 
+                {
+                    changed.push_back(start);
+                }
+                trackChanges = true;
+            }
+            sort(changed.begin(), changed.end());
+            changedAddresses.clear();
+
+            if (outputFile.json()) 
+            {
+                string changedJson = "[", freedJson = "[";
+                for (Address start : changed) 
+                {
+                    auto tableIt = blockAtAddress.find(start);
+                    if (tableIt != blockAtAddress.end()) 
+                    {
+                        changedJson += (changedJson.size() > 1 ? "," : "") + blockJson(outputFile, *tableIt->second);
+                    }
+                    else 
+                    {
+                        freedJson += (freedJson.size() > 1 ? "," : "") + to_string(start);
+                    }
+                }
+                outputFile.message(OutputSink::Summary).rawField("changedBlocks", changedJson + "]").rawField("freedBlocks", freedJson + "]")
+                          .field("totalAllocated", allocatedBytes).field("totalFree", freeMemory());
+                return;
+            }
+            outputFile.message(OutputSink::Summary);
+            outputFile << "\n";
+            outputFile << "Changed Blocks:\n";
+            for (Address start : changed) 
+            {
+                auto tableIt = blockAtAddress.find(start);
+                if (tableIt != blockAtAddress.end()) 
+                {
+                    writeBlock(outputFile, *tableIt->second);
+                }
+                else 
+                {
+                    outputFile << "Start: " << start << ", Freed\n";
+                }
+            }
+            outputFile << "Total Memory Allocated: " << allocatedBytes << " bytes\n";
+            outputFile << "Total Memory Free: " << freeMemory() << " bytes\n\n";
+        }
+
+        /***************************************************************
+        Function: freeBlockSizeHistogram
+        Use: Counts the free blocks by size.
+        Arguments: none
+        Returns: A vector where entry i is the number of free blocks with a size in [2^i, 2^(i+1)).
+        Notes: Walks the placement policy's free block list, so it costs O(number of free blocks).
+        ***************************************************************/
+        vector<long long> freeBlockSizeHistogram() const
+        {
+            vector<long long> histogram(numeric_limits<Address>::digits, 0);
+            for (const auto& freeBlock : placement->freeBlockList()) 
+            {
+                histogram[bit_width(static_cast<make_unsigned_t<Address>>(freeBlock.size)) - 1]++;
+            }
+            return histogram;
+        }
+
+        /***************************************************************
+        Function: printStatistics
+        Use: Writes the operation counters, latencies and free space gauges.
+        Arguments: outputFile - the output sink to write to.
+        Returns: nothing
+        Notes: For each operation this gives the calls, failures and the mean, p50, p99 and
+        maximum latency, then the compaction totals, the free memory, hole count and
+        largest free block, and the free block size histogram. In JSON-lines mode it is
+        one record with the operations as an object, including their raw latency buckets.
+        ***************************************************************/
+        void printStatistics(OutputSink & outputFile) const
+        {
+            const pair<const char*, const OperationStatistics*> operations[] = {
+                {"allocate", &statistics.allocate}, {"free", &statistics.free},
+                {"reference", &statistics.reference}, {"unfragment", &statistics.unfragment},
+                {"compactStep", &statistics.compactStep}, {"compactToFit", &statistics.compactToFit},
+                {"allocateBatch", &statistics.allocateBatch}, {"freeBatch", &statistics.freeBatch}};
+            vector<long long> freeBlockSizes = freeBlockSizeHistogram();
+            if (outputFile.json()) 
+            {
+                string operationsJson = "{", freeBlockSizesJson = "[";
+                for (const auto& [name, operation] : operations) 
+                {
+                    const LatencyHistogram& latency = operation->latency;
+                    operationsJson += string(operationsJson.size() > 1 ? ",\"" : "\"") + name + "\":{\"calls\":" + to_string(operation->calls)
+                                      + ",\"failures\":" + to_string(operation->failures) + ",\"meanNs\":" + to_string(latency.mean())
+                                      + ",\"p50Ns\":" + to_string(latency.percentile(0.5)) + ",\"p99Ns\":" + to_string(latency.percentile(0.99))
+                                      + ",\"maxNs\":" + to_string(latency.maximum()) + ",\"latencyBuckets\":[";
+                    for (int index = 0; index < LatencyHistogram::bucketCount; ++index) 
+                    {
+                        operationsJson += (index > 0 ? "," : "") + to_string(latency.bucket(index));
+                    }
+                    operationsJson += "]}";
+                }
+                for (size_t index = 0; index < freeBlockSizes.size(); ++index) 
+                {
+                    freeBlockSizesJson += (index > 0 ? "," : "") + to_string(freeBlockSizes[index]);
+                }
+                outputFile.message(OutputSink::Summary).rawField("operations", operationsJson + "}")
+                          .field("bytesMoved", statistics.bytesMoved).field("blocksMoved", statistics.blocksMoved)
+                          .field("freeMemory", freeMemory()).field("holes", placement->freeBlockCount())
+                          .field("largestFreeBlock", placement->largestFreeBlock()).rawField("freeBlockSizes", freeBlockSizesJson + "]");
+                if (slabCache.enabled()) 
+                {
+                    const SlabStatistics& slabCounters = slabCache.statistics();
+                    outputFile.rawField("slabs", "{\"requests\":" + to_string(slabCounters.requests) + ",\"hits\":" + to_string(slabCounters.hits)
+                                                 + ",\"slabsCreated\":" + to_string(slabCounters.slabsCreated) + ",\"slabsReturned\":" + to_string(slabCounters.slabsReturned)
+                                                 + ",\"fallbacks\":" + to_string(slabCounters.fallbacks) + ",\"slabs\":" + to_string(slabCache.slabCount())
+                                                 + ",\"reservedBytes\":" + to_string(slabCache.reservedBytes()) + ",\"heldBytes\":" + to_string(slabCache.heldBytes())
+                                                 + ",\"overheadBytes\":" + to_string(slabCache.reservedBytes() - slabCache.heldBytes()) + "}");
+                }
+                return;
+            }
+            outputFile.message(OutputSink::Summary);
+            outputFile << "Statistics:\n";
+            for (const auto& [name, operation] : operations) 
+            {
+                const LatencyHistogram& latency = operation->latency;
+                outputFile << name << ": " << operation->calls << " calls, " << operation->failures << " failed, mean " << latency.mean()
+                           << " ns, p50 " << latency.percentile(0.5) << " ns, p99 " << latency.percentile(0.99) << " ns, max " << latency.maximum() << " ns\n";
+            }
+            outputFile << "Compaction moved " << statistics.bytesMoved << " bytes in " << statistics.blocksMoved << " blocks in total\n";
+            outputFile << "Free memory: " << freeMemory() << " bytes in " << placement->freeBlockCount() << " holes, largest free block "
+                       << placement->largestFreeBlock() << " bytes\n";
+            outputFile << "Free block sizes:";
+            for (size_t index = 0; index < freeBlockSizes.size(); ++index) 
+            {
+                if (freeBlockSizes[index] > 0) 
+                {
+                    outputFile << " " << (1LL << index) << "-" << (1LL << (index + 1)) - 1 << ": " << freeBlockSizes[index];
+                }
+            }
+            outputFile << "\n";
+            if (slabCache.enabled()) 
+            {
+                const SlabStatistics& slabCounters = slabCache.statistics();
+                long long overhead = slabCache.reservedBytes() - slabCache.heldBytes();
+                outputFile << "Slabs: " << slabCounters.requests << " requests, " << slabCounters.hits << " hits ("
+                           << (slabCounters.requests == 0 ? 0.0 : round(1000.0 * slabCounters.hits / slabCounters.requests) / 10) << "%), "
+                           << slabCounters.slabsCreated << " slabs created, " << slabCounters.slabsReturned << " returned, " << slabCounters.fallbacks
+                           << " fallbacks, " << slabCache.slabCount() << " slabs holding " << slabCache.heldBytes() << " of " << slabCache.reservedBytes()
+                           << " bytes, overhead " << overhead << " bytes (" << round(1000.0 * overhead / totalMemory) / 10 << "% of memory)\n";
+            }
+            outputFile << "\n";
+        }
+
+};
+
+/***************************************************************
+Class: LockFreeStack
+
+Use: A stack of ints that any number of threads can push to while
+one thread at a time takes everything off it. The sharded manager
+uses it to hand frees to the shard that owns an address.
+
+Notes: push is a compare-and-swap loop on the head pointer and
+takes no lock. takeAll swaps the whole list out in one exchange
+instead of popping nodes one by one, so a node can never be freed
+while a pusher still looks at it, and the ABA problem cannot occur.
+Values come out newest first.
+***************************************************************/
+class LockFreeStack
+{
+    private:
+        struct Node
+        {
+            int value;
+            Node* next;
+        };
+        atomic<Node*> head{nullptr};
+    public:
+        LockFreeStack() = default;
+        LockFreeStack(const LockFreeStack&) = delete;
+        LockFreeStack& operator=(const LockFreeStack&) = delete;
+        ~LockFreeStack() { takeAll([](int) {}); }
+
+        void push(int value)
+        {
+            Node* node = new Node{value, head.load(memory_order_relaxed)};
+            while (!head.compare_exchange_weak(node->next, node, memory_order_release, memory_order_relaxed)) {}
+        }
+
+        // Empties the stack, calling visit for every value on it, and returns how many there were
+        template <typename Visit>
+        int takeAll(Visit visit)
+        {
+            Node* node = head.exchange(nullptr, memory_order_acquire);
+            int count = 0;
+            while (node) 
+            {
+                Node* next = node->next;
+                visit(node->value);
+                delete node;
+                node = next;
+                count++;
+            }
+            return count;
+        }
+};
+
+/***************************************************************
+Class: SpscRing
+
+Use: A bounded queue from exactly one producing thread to exactly
+one consuming thread. The stages of a pipelined replay are connected
+with it.
+
+Notes: The slots are indexed by two counters that only ever grow,
+each written by one side only, so push and pop take no lock. A push
+to a full ring or a pop from an empty one yields until the other
+side moves, which keeps a waiting stage from starving its neighbour
+when there are fewer cores than stages. After close, pop still
+returns what is left and then reports the end.
+***************************************************************/
+template <typename Item>
+class SpscRing
+{
+    private:
+        vector<Item> slots;
+        alignas(64) atomic<size_t> head{0};   // Next slot to pop, written by the consumer
+        alignas(64) atomic<size_t> tail{0};   // Next slot to push, written by the producer
+        atomic<bool> closed{false};
+    public:
+        explicit SpscRing(size_t capacity) : slots(capacity) {}
+
+        void push(Item item)
+        {
+            size_t position = tail.load(memory_order_relaxed);
+            while (position - head.load(memory_order_acquire) == slots.size()) 
+            {
+                this_thread::yield();
+            }
+            slots[position % slots.size()] = std::move(item);
+            tail.store(position + 1, memory_order_release);
+        }
+
+        // Takes the oldest item, waiting for one if needed; false once the ring is closed and empty
+        bool pop(Item& item)
+        {
+            size_t position = head.load(memory_order_relaxed);
+            while (position == tail.load(memory_order_acquire)) 
+            {
+                if (closed.load(memory_order_acquire) && position == tail.load(memory_order_acquire)) 
+                {
+                    return false;
+                }
+                this_thread::yield();
+            }
+            item = std::move(slots[position % slots.size()]);
+            head.store(position + 1, memory_order_release);
+            return true;
+        }
+
+        // Called by the producer after its last push
+        void close()
+        {
+            closed.store(true, memory_order_release);
+        }
+};
+
+/***************************************************************
+Struct: ShardStatistics
+
+Use: Counters of a ShardedMemoryManager, summed over its shards.
+***************************************************************/
+struct ShardStatistics
+{
+    long long allocations = 0,
+              failedAllocations = 0,
+              stolenAllocations = 0, // Allocations served from another shard's free space
+              remoteFrees = 0, // Frees handed to the owning shard through its queue
+              invalidFrees = 0; // Frees of addresses that were not allocated, which are ignored
+};
+
+/***************************************************************
+Class: ShardedMemoryManager
+
+Use: A memory manager that many threads can allocate from and free
+to at the same time. It works with addresses and sizes only; the
+variables, references and compaction of MemoryManager are not part
+of it.
+
+Notes: The address space is split into one contiguous shard per
+thread, and every shard has its own placement policy and block
+sizes behind its own lock. A thread passes its home shard to every
+call, and allocates from that shard, so the lock is normally taken
+by one thread only and never waited for.
+A free goes to the shard that owns the address. When that is not
+the caller's shard, the address is pushed to the owner's lock-free
+queue instead of taking the owner's lock, and the owner applies
+the queued frees the next time it allocates.
+When the home shard has no free block large enough, the other
+shards are tried in turn and the block is taken from the first one
+that has room. A stolen block stays in its owner's address range,
+so it goes back to the owner when it is freed.
+With a single shard this is one allocator behind one lock, which is
+the baseline mtbench compares against.
+***************************************************************/
+class ShardedMemoryManager
+{
+    private:
+        struct alignas(64) Shard
+        {
+            int base,
+                size;
+            mutex lock;
+            unique_ptr<PlacementPolicy<int>> placement; // Free space in shard addresses, [0, size)
+            unordered_map<int, int> blockSizes; // Shard address -> size of each allocated block
+            int allocatedBytes = 0;
+            LockFreeStack freeQueue; // Shard addresses freed by threads of other shards
+            atomic<long long> allocations{0},
+                              failedAllocations{0},
+                              stolenAllocations{0},
+                              remoteFrees{0},
+                              invalidFrees{0};
+        };
+
+        int totalMemory,
+            shardSize;
+        vector<unique_ptr<Shard>> shards;
+
+        // Frees a block by its shard address. The caller holds the shard's lock.
+        bool releaseLocked(Shard& shard, int start)
+        {
+            auto it = shard.blockSizes.find(start);
+            if (it == shard.blockSizes.end()) 
+            {
+                shard.invalidFrees.fetch_add(1, memory_order_relaxed);
+                return false;
+            }
+            shard.placement->release(start, it->second);
+            shard.allocatedBytes -= it->second;
+            shard.blockSizes.erase(it);
+            return true;
+        }
+
+        // Applies the frees queued by other threads. The caller holds the shard's lock.
+        void drainLocked(Shard& shard)
+        {
+            shard.freeQueue.takeAll([&](int start) { releaseLocked(shard, start); });
+        }
+
+        // Allocates in a shard and returns the global address, or -1. The caller holds the shard's lock.
+        int allocateLocked(Shard& shard, int size)
+        {
+            drainLocked(shard);
+            size = shard.placement->blockSize(size);
+            int start = shard.placement->allocate(size);
+            if (start < 0) 
+            {
+                return -1;
+            }
+            shard.blockSizes.emplace(start, size);
+            shard.allocatedBytes += size;
+            shard.allocations.fetch_add(1, memory_order_relaxed);
+            return shard.base + start;
+        }
+    public:
+        /***************************************************************
+        Function: ShardedMemoryManager
+
+        Use: Splits size bytes into shardCount shards of equal size, the
+        last one taking the remainder.
+
+        Arguments: 1. size - the total memory size.
+                   2. shardCount - the number of shards, normally the number of threads.
+                   3. policyName - the placement policy of every shard, as for makePlacementPolicy.
+
+        Returns: Nothing.
+
+        Notes: policyName must be a valid policy name, and every shard must get at least one byte.
+        ***************************************************************/
+        ShardedMemoryManager(int size, int shardCount, const string& policyName) : totalMemory(size), shardSize(size / shardCount)
+        {
+            for (int index = 0; index < shardCount; ++index) 
+            {
+                auto shard = make_unique<Shard>();
+                shard->base = index * shardSize;
+                shard->size = index + 1 == shardCount ? size - shard->base : shardSize;
+                shard->placement = makePlacementPolicy<int>(policyName);
+                shard->placement->reset(0, shard->size);
+                shards.push_back(std::move(shard));
+            }
+        }
+
+        int shardCount() const { return static_cast<int>(shards.size()); }
+
+        /***************************************************************
+        Function: allocate
+
+        Use: Allocates size bytes for a thread.
+
+        Arguments: 1. home - the caller's shard, taken modulo the shard count.
+                   2. size - the number of bytes, at least 1.
+
+        Returns: The address of the block, or -1 if no shard has room.
+        ***************************************************************/
+        int allocate(int home, int size)
+        {
+            int count = shardCount();
+            Shard& own = *shards[home % count];
+            {
+                lock_guard<mutex> guard(own.lock);
+                int address = allocateLocked(own, size);
+                if (address >= 0) 
+                {
+                    return address;
+                }
+            }
+            for (int offset = 1; offset < count; ++offset) 
+            {
+                Shard& victim = *shards[(home + offset) % count];
+                lock_guard<mutex> guard(victim.lock);
+                int address = allocateLocked(victim, size);
+                if (address >= 0) 
+                {
+                    victim.stolenAllocations.fetch_add(1, memory_order_relaxed);
+                    return address;
+                }
+            }
+            own.failedAllocations.fetch_add(1, memory_order_relaxed);
+            return -1;
+        }
+
+        /***************************************************************
+        Function: deallocate
+
+        Use: Frees the block at an address, from any thread.
+
+        Arguments: 1. home - the caller's shard, taken modulo the shard count.
+                   2. address - the address allocate returned.
+
+        Returns: false if the address is outside the memory or, for a
+        free of the caller's own shard, not an allocated block.
+
+        Notes: A free for another shard is queued and checked when the
+        owner applies it; an invalid one is then only counted.
+        ***************************************************************/
+        bool deallocate(int home, int address)
+        {
+            if (address < 0 || address >= totalMemory) 
+            {
+                return false;
+            }
+            int count = shardCount();
+            int owner = min(address / shardSize, count - 1);
+            Shard& shard = *shards[owner];
+            if (owner != home % count) 
+            {
+                shard.freeQueue.push(address - shard.base);
+                shard.remoteFrees.fetch_add(1, memory_order_relaxed);
+                return true;
+            }
+            lock_guard<mutex> guard(shard.lock);
+            return releaseLocked(shard, address - shard.base);
+        }
+
+        // Applies every queued free and returns the allocated bytes of all shards
+        int allocatedMemory()
+        {
+            int total = 0;
+            for (auto& shard : shards) 
+            {
+                lock_guard<mutex> guard(shard->lock);
+                drainLocked(*shard);
+                total += shard->allocatedBytes;
+            }
+            return total;
+        }
+
+        /***************************************************************
+        Function: consistent
+
+        Use: Checks every shard after applying its queued frees.
+
+        Arguments: None.
+
+        Returns: true if, in every shard, the free blocks and the allocated
+        blocks do not overlap and together cover the shard exactly.
+        ***************************************************************/
+        bool consistent()
+        {
+            for (auto& shard : shards) 
+            {
+                lock_guard<mutex> guard(shard->lock);
+                drainLocked(*shard);
+                vector<FreeBlock<int>> blocks = shard->placement->freeBlockList();
+                for (const auto& [start, size] : shard->blockSizes) 
+                {
+                    blocks.push_back({start, size});
+                }
+                sort(blocks.begin(), blocks.end(), [](const FreeBlock<int>& a, const FreeBlock<int>& b) { return a.start < b.start; });
+                int expected = 0;
+                for (const auto& block : blocks) 
+                {
+                    if (block.start != expected) 
+                    {
+                        return false;
+                    }
+                    expected += block.size;
+                }
+                if (expected != shard->size) 
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        ShardStatistics statistics() const
+        {
+            ShardStatistics total;
+            for (const auto& shard : shards) 
+            {
+                total.allocations += shard->allocations.load(memory_order_relaxed);
+                total.failedAllocations += shard->failedAllocations.load(memory_order_relaxed);
+                total.stolenAllocations += shard->stolenAllocations.load(memory_order_relaxed);
+                total.remoteFrees += shard->remoteFrees.load(memory_order_relaxed);
+                total.invalidFrees += shard->invalidFrees.load(memory_order_relaxed);
+            }
+            return total;
+        }
+};
+
+/***************************************************************
+Struct: Transaction
+
+Use: One decoded line of the transaction language.
+
+Notes: first and second point into the line they were parsed from
+(the variable name, or the two names of a reference), so they are
+only valid while that text is.
+***************************************************************/
+struct Transaction
+{
+    enum Type { Allocate, Free, Reference, Print, Check, Stats, PrintSummary, PrintDelta, Batch, BatchEnd, Unknown } type;
+    long long size;
+    string_view first,
+                second;
+};
+
+const size_t replayBatchSize = 4096; // Transactions per batch handed from the parser to the executor
+
+/***************************************************************
+Function: nextToken
+
+Use: Splits the next whitespace separated token off a line.
+
+Arguments: rest - the unparsed part of the line, advanced past the token.
+
+Returns: The token, or an empty view if the line has no more tokens.
+***************************************************************/
+string_view nextToken(string_view& rest)
+{
+    size_t start = 0;
+    while (start < rest.size() && isspace(static_cast<unsigned char>(rest[start]))) 
+    {
+        start++;
+    }
+    size_t end = start;
+    while (end < rest.size() && !isspace(static_cast<unsigned char>(rest[end]))) 
+    {
+        end++;
+    }
+    string_view token = rest.substr(start, end - start);
+    rest.remove_prefix(end);
+    return token;
+}
+
+/***************************************************************
+Function: parseInteger
+
+Use: Parses a decimal integer with an optional sign.
+
+Arguments: 1. token: the text to parse.
+           2. value: receives the parsed value.
+
+Returns: true if the whole token is an integer that fits in a long long.
+***************************************************************/
+bool parseInteger(string_view token, long long& value)
+{
+    size_t position = 0;
+    bool negative = false;
+    if (!token.empty() && (token[0] == '-' || token[0] == '+')) 
+    {
+        negative = token[0] == '-';
+        position = 1;
+    }
+    if (position == token.size()) 
+    {
+        return false;
+    }
+    long long result = 0;
+    for (; position < token.size(); ++position) 
+    {
+        char digit = token[position];
+        if (digit < '0' || digit > '9') 
+        {
+            return false;
+        }
+        if (result > (numeric_limits<long long>::max() - (digit - '0')) / 10) 
+        {
+            return false;
+        }
+        result = result * 10 + (digit - '0');
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+/***************************************************************
+Function: parseTransaction
+
+Use: Decodes one line of the transaction language in place.
+
+Arguments: line - the text of the line, without its newline.
+
+Returns: The decoded transaction. Its names point into line.
+
+Notes: Nothing is copied or allocated. An allocate line whose size is
+not a number gets size 0 and an empty name, which allocateMemory
+reports as an empty variable name, as reading into an int from a
+stream did before.
+***************************************************************/
+Transaction parseTransaction(string_view line)
+{
+    Transaction transaction = {Transaction::Unknown, 0, {}, {}};
+    string_view type = nextToken(line);
+    if (type == "allocate") 
+    {
+        transaction.type = Transaction::Allocate;
+        if (parseInteger(nextToken(line), transaction.size)) 
+        {
+            transaction.first = nextToken(line);
+        }
+        else 
+        {
+            transaction.size = 0;
+        }
+    }
+    else if (type == "free") 
+    {
+        transaction.type = Transaction::Free;
+        transaction.first = nextToken(line);
+    }
+    else if (type == "reference") 
+    {
+        transaction.type = Transaction::Reference;
+        transaction.first = nextToken(line);
+        transaction.second = nextToken(line);
+    }
+    else if (type == "print") 
+    {
+        string_view mode = nextToken(line);
+        transaction.type = mode.empty() ? Transaction::Print
+                         : mode == "summary" ? Transaction::PrintSummary
+                         : mode == "delta" ? Transaction::PrintDelta
+                         : Transaction::Unknown;
+    }
+    else if (type == "check") 
+    {
+        transaction.type = Transaction::Check;
+    }
+    else if (type == "stats") 
+    {
+        transaction.type = Transaction::Stats;
+    }
+    else if (type == "batch") 
+    {
+        transaction.type = Transaction::Batch;
+    }
+    else if (type == "end") 
+    {
+        transaction.type = Transaction::BatchEnd;
+    }
+    return transaction;
+}
+
+/***************************************************************
+Class: MappedFile
+
+Use: Gives read-only access to a whole input file as one string_view.
+
+Notes: On POSIX systems the file is memory-mapped with a sequential
+access hint, so the trace is read straight from the page cache.
+Elsewhere it is read into a buffer in one go.
+***************************************************************/
+class MappedFile
+{
+    private:
+        const char* data = nullptr;
+        size_t length = 0;
+        string buffer;
+#if defined(__unix__) || defined(__APPLE__)
+        bool mapped = false;
+#endif
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile()
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            if (mapped) 
+            {
+                munmap(const_cast<char*>(data), length);
+            }
+#endif
+        }
+
+        /***************************************************************
+        Function: open
+
+        Use: Maps or reads the given file.
+
+        Arguments: path - the file to open.
+
+        Returns: true on success, false if the file cannot be opened.
+        ***************************************************************/
+        bool open(const string& path)
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            int descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor < 0) 
+            {
+                return false;
+            }
+            struct stat fileStatus;
+            if (fstat(descriptor, &fileStatus) != 0) 
+            {
+                ::close(descriptor);
+                return false;
+            }
+            length = static_cast<size_t>(fileStatus.st_size);
+            if (length > 0) 
+            {
+                void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                if (address == MAP_FAILED) 
+                {
+                    ::close(descriptor);
+                    return false;
+                }
+                madvise(address, length, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(address);
+                mapped = true;
+            }
+            ::close(descriptor);
+            return true;
+#else
+            ifstream file(path, ios::binary);
+            if (!file.is_open()) 
+            {
+                return false;
+            }
+            buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+            data = buffer.data();
+            length = buffer.size();
+            return true;
+#endif
+        }
+
+        string_view contents() const { return string_view(data, length); }
+};
+
+/***************************************************************
+Binary trace format, version 1
+
+The file starts with the 7 bytes "MMTRACE" and a version byte.
+Each record is a one byte opcode followed by its operands:
+    1 Allocate:  size (zigzag varint), name
+    2 Free:      name
+    3 Reference: name, name
+    4 Print, 5 Check, 6 Unknown, 7 Stats, 8 Print summary,
+    9 Print delta: no operands
+Numbers are LEB128 varints. Every name is interned. A name operand
+is a varint v: 0 means a new name follows, stored as the length of
+the prefix it shares with the previous new name, the length of the
+rest and the rest's bytes, and it gets the next id. Otherwise v
+refers to the name with id (names so far - v), so recently seen names
+cost one or two bytes.
+***************************************************************/
+const char binaryTraceMagic[7] = {'M', 'M', 'T', 'R', 'A', 'C', 'E'};
+const uint8_t binaryTraceVersion = 1;
+const Transaction::Type binaryTraceOpcodes[] = {Transaction::Unknown, Transaction::Allocate, Transaction::Free,
+                                                Transaction::Reference, Transaction::Print, Transaction::Check, Transaction::Unknown,
+                                                Transaction::Stats, Transaction::PrintSummary, Transaction::PrintDelta,
+                                                Transaction::Batch, Transaction::BatchEnd};
+
+/***************************************************************
+Function: binaryTraceOpcode
+
+Use: Gives the opcode a transaction type is stored with.
+
+Arguments: type - the transaction type.
+
+Returns: The opcode, its index in binaryTraceOpcodes.
+***************************************************************/
+uint8_t binaryTraceOpcode(Transaction::Type type)
+{
+    for (uint8_t opcode = 1; opcode < size(binaryTraceOpcodes); ++opcode) 
+    {
+        if (binaryTraceOpcodes[opcode] == type) 
+        {
+            return opcode;
+        }
+    }
+    return 6; // Unknown
+}
+
+/***************************************************************
+Function: isBinaryTrace
+
+Use: Checks whether a file starts with the binary trace header.
+
+Arguments: path - the file to check.
+
+Returns: true if the file is a binary trace.
+***************************************************************/
+bool isBinaryTrace(const string& path)
+{
+    ifstream file(path, ios::binary);
+    char header[sizeof(binaryTraceMagic)];
+    return file.read(header, sizeof(header)) && equal(begin(header), end(header), begin(binaryTraceMagic));
+}
+
+/***************************************************************
+Class: BinaryTraceWriter
+
+Use: Encodes transactions into the binary trace format.
+
+Notes: Records are built in a large buffer that is written out
+whenever it fills, and on close.
+***************************************************************/
+class BinaryTraceWriter
+{
+    private:
+        ofstream file;
+        vector<char> buffer;
+        unordered_map<string, uint32_t, StringHash, equal_to<>> symbolIds;
+        string previousName;
+
+        void flushIfFull()
+        {
+            if (buffer.size() >= (1 << 20)) 
+            {
+                file.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+
+        void writeVarint(uint64_t value)
+        {
+            while (value >= 0x80) 
+            {
+                buffer.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            buffer.push_back(static_cast<char>(value));
+        }
+
+        void writeName(string_view name)
+        {
+            auto symbolIt = symbolIds.find(name);
+            if (symbolIt != symbolIds.end()) 
+            {
+                writeVarint(symbolIds.size() - symbolIt->second);
+                return;
+            }
+            size_t shared = 0;
+            while (shared < name.size() && shared < previousName.size() && name[shared] == previousName[shared]) 
+            {
+                shared++;
+            }
+            writeVarint(0);
+            writeVarint(shared);
+            writeVarint(name.size() - shared);
+            buffer.insert(buffer.end(), name.begin() + shared, name.end());
+            symbolIds.emplace(name, static_cast<uint32_t>(symbolIds.size()));
+            previousName = name;
+        }
+    public:
+        bool open(const string& path)
+        {
+            file.open(path, ios::binary);
+            if (!file.is_open()) 
+            {
+                return false;
+            }
+            buffer.insert(buffer.end(), begin(binaryTraceMagic), end(binaryTraceMagic));
+            buffer.push_back(static_cast<char>(binaryTraceVersion));
+            return true;
+        }
+
+        void write(const Transaction& transaction)
+        {
+            buffer.push_back(static_cast<char>(binaryTraceOpcode(transaction.type)));
+            if (transaction.type == Transaction::Allocate) 
+            {
+                int64_t size = transaction.size;
+                writeVarint(static_cast<uint64_t>((size << 1) ^ (size >> 63)));
+                writeName(transaction.first);
+            }
+            else if (transaction.type == Transaction::Free) 
+            {
+                writeName(transaction.first);
+            }
+            else if (transaction.type == Transaction::Reference) 
+            {
+                writeName(transaction.first);
+                writeName(transaction.second);
+            }
+            flushIfFull();
+        }
+
+        bool close()
+        {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
+            file.close();
+            return !file.fail();
+        }
+};
+
+/***************************************************************
+Class: BinaryTraceReader
+
+Use: Decodes a binary trace one transaction at a time.
+
+Notes: The file is read with large sequential reads into a 4 MB
+buffer. Interned names are kept in a deque so the string_views
+handed out in transactions stay valid until the reader is destroyed.
+***************************************************************/
+class BinaryTraceReader
+{
+    private:
+        ifstream file;
+        vector<char> buffer = vector<char>(1 << 22);
+        size_t position = 0,
+               filled = 0;
+        deque<string> symbols;
+        bool corrupt = false;
+
+        int readByte()
+        {
+            if (position == filled) 
+            {
+                file.read(buffer.data(), buffer.size());
+                filled = static_cast<size_t>(file.gcount());
+                position = 0;
+                if (filled == 0) 
+                {
+                    return -1;
+                }
+            }
+            return static_cast<unsigned char>(buffer[position++]);
+        }
+
+        bool readVarint(uint64_t& value)
+        {
+            value = 0;
+            for (int shift = 0; shift < 64; shift += 7) 
+            {
+                int byte = readByte();
+                if (byte < 0) 
+                {
+                    return false;
+                }
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if (byte < 0x80) 
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool readName(string_view& name)
+        {
+            uint64_t reference;
+            if (!readVarint(reference)) 
+            {
+                return false;
+            }
+            if (reference > 0) 
+            {
+                if (reference > symbols.size()) 
+                {
+                    return false;
+                }
+                name = symbols[symbols.size() - reference];
+                return true;
+            }
+            uint64_t shared, rest;
+            if (!readVarint(shared) || !readVarint(rest) || (!symbols.empty() && shared > symbols.back().size()) || (symbols.empty() && shared > 0)) 
+            {
+                return false;
+            }
+            string text = symbols.empty() ? string() : symbols.back().substr(0, shared);
+            for (uint64_t i = 0; i < rest; ++i) 
+            {
+                int byte = readByte();
+                if (byte < 0) 
+                {
+                    return false;
+                }
+                text.push_back(static_cast<char>(byte));
+            }
+            symbols.push_back(std::move(text));
+            name = symbols.back();
+            return true;
+        }
+    public:
+        /***************************************************************
+        Function: open
+
+        Use: Opens a binary trace and checks its header.
+
+        Arguments: path - the file to open.
+
+        Returns: true if the file is a binary trace of a supported version.
+        ***************************************************************/
+        bool open(const string& path)
+        {
+            file.open(path, ios::binary);
+            char header[sizeof(binaryTraceMagic) + 1];
+            if (!file.read(header, sizeof(header)) || !equal(begin(binaryTraceMagic), end(binaryTraceMagic), header)) 
+            {
+                return false;
+            }
+            return static_cast<uint8_t>(header[sizeof(binaryTraceMagic)]) == binaryTraceVersion;
+        }
+
+        /***************************************************************
+        Function: next
+
+        Use: Decodes the next transaction.
+
+        Arguments: transaction - receives the transaction.
+
+        Returns: true if a transaction was read, false at the end of the
+        trace or on a malformed record (see failed).
+        ***************************************************************/
+        bool next(Transaction& transaction)
+        {
+            int opcode = readByte();
+            if (opcode < 0) 
+            {
+                return false;
+            }
+            if (opcode == 0 || opcode >= static_cast<int>(size(binaryTraceOpcodes))) 
+            {
+                corrupt = true;
+                return false;
+            }
+            transaction = {binaryTraceOpcodes[opcode], 0, {}, {}};
+            bool complete = true;
+            if (transaction.type == Transaction::Allocate) 
+            {
+                uint64_t size;
+                complete = readVarint(size) && readName(transaction.first);
+                transaction.size = static_cast<int64_t>(size >> 1) ^ -static_cast<int64_t>(size & 1);
+            }
+            else if (transaction.type == Transaction::Free) 
+            {
+                complete = readName(transaction.first);
+            }
+            else if (transaction.type == Transaction::Reference) 
+            {
+                complete = readName(transaction.first) && readName(transaction.second);
+            }
+            corrupt = !complete;
+            return complete;
+        }
+
+        bool failed() const { return corrupt; }
+};
+
+/***************************************************************
+Function: writeTextTransaction
+
+Use: Writes a transaction as one line of the text language.
+
+Arguments: 1. output: the stream to write to.
+           2. transaction: the transaction to write.
+
+Returns: Nothing.
+***************************************************************/
+void writeTextTransaction(ostream& output, const Transaction& transaction)
+{
+    switch (transaction.type) 
+    {
+        case Transaction::Allocate: output << "allocate " << transaction.size << " " << transaction.first << "\n"; break;
+        case Transaction::Free: output << "free " << transaction.first << "\n"; break;
+        case Transaction::Reference: output << "reference " << transaction.first << " " << transaction.second << "\n"; break;
+        case Transaction::Print: output << "print\n"; break;
+        case Transaction::Check: output << "check\n"; break;
+        case Transaction::Stats: output << "stats\n"; break;
+        case Transaction::PrintSummary: output << "print summary\n"; break;
+        case Transaction::PrintDelta: output << "print delta\n"; break;
+        case Transaction::Batch: output << "batch\n"; break;
+        case Transaction::BatchEnd: output << "end\n"; break;
+        default: output << "unknown\n"; break;
+    }
+}
+
+/***************************************************************
+Function: convertTrace
+
+Use: Converts a trace between the text and binary formats.
+
+Arguments: 1. inputPath: the trace to convert. A binary trace becomes
+              text and anything else is read as text and becomes binary.
+           2. outputPath: where to write the converted trace.
+
+Returns: 0 on success, 1 on an error.
+
+Notes: Transaction types the text parser does not recognise are kept
+as Unknown records and written back as "unknown", so replaying either
+form gives the same output.
+***************************************************************/
+int convertTrace(const string& inputPath, const string& outputPath)
+{
+    if (isBinaryTrace(inputPath)) 
+    {
+        BinaryTraceReader reader;
+        ofstream output(outputPath, ios::binary);
+        if (!reader.open(inputPath) || !output.is_open()) 
+        {
+            cerr << "Error opening trace files or unsupported binary trace version.\n";
+            return 1;
+        }
+        Transaction transaction;
+        while (reader.next(transaction)) 
+        {
+            writeTextTransaction(output, transaction);
+        }
+        if (reader.failed()) 
+        {
+            cerr << "Error: malformed binary trace.\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    MappedFile input;
+    BinaryTraceWriter writer;
+    if (!input.open(inputPath) || !writer.open(outputPath)) 
+    {
+        cerr << "Error opening trace files.\n";
+        return 1;
+    }
+    string_view remaining = input.contents();
+    while (!remaining.empty()) 
+    {
+        size_t lineEnd = remaining.find('\n');
+        writer.write(parseTransaction(remaining.substr(0, lineEnd)));
+        remaining = lineEnd == string_view::npos ? string_view() : remaining.substr(lineEnd + 1);
+    }
+    return writer.close() ? 0 : 1;
+}
+
+/***************************************************************
+Class: DefragmentationScheduler
+
+Use: Decides when the memory should be compacted.
+
+Notes: In fixed mode the memory is compacted after every k successful
+deallocations and on every failed allocation, regardless of the state
+of the heap.
+In adaptive mode, after at least k deallocations since the last
+compaction, the scheduler looks at the external fragmentation,
+1 - (largest free block / total free memory), and at the hole count,
+all of which are kept up to date by the manager and the placement
+policy. It compacts when there are at least two holes, the
+fragmentation is at least the threshold, and the benefit is at least
+costWeight times the relocation cost. The benefit is the free memory
+that would join the largest free block. The relocation cost is the
+allocated memory above the lowest hole, which is exactly what
+unfragment moves. A threshold of 0 leaves only the cost model, and a
+cost weight of 0 leaves only the threshold. A failed allocation is
+only followed by a compaction if the total free memory could hold the
+request.
+Incremental mode uses the adaptive decision to start a compaction, but
+never compacts all at once: the compaction is spread over the following
+transactions, one compactStep within the step budget after each, until
+the memory is dense or the steps have moved as much as unfragment would
+have when the compaction started. Without that limit, holes freed behind
+the steps would keep the compaction going forever, moving the same
+blocks again and again. A failed allocation compacts only until the request
+fits, moving at most fitBudget bytes. This bounds the compaction work in
+any one transaction.
+***************************************************************/
+class DefragmentationScheduler
+{
+    public:
+        enum Mode { Fixed, Adaptive, Incremental };
+    private:
+        Mode mode;
+        int k,
+            deallocationsSinceCompaction = 0;
+        double threshold,
+               costWeight;
+        CompactionBudget step;
+        int fitBudget;
+        bool compacting = false; // An incremental compaction is in progress
+        long long compactionBytesLeft = 0; // What unfragment would have moved when it started
+    public:
+        DefragmentationScheduler(Mode mode, int k, double threshold = 0.5, double costWeight = 0.5,
+                                 CompactionBudget step = {1 << 16, 256, chrono::nanoseconds(0)}, int fitBudget = 1 << 20)
+            : mode(mode), k(k), threshold(threshold), costWeight(costWeight), step(step), fitBudget(fitBudget) {}
+
+        bool incremental() const { return mode == Incremental; }
+        const CompactionBudget& stepBudget() const { return step; }
+        int fitByteBudget() const { return fitBudget; }
+
+        /***************************************************************
+        Function: afterDeallocation
+
+        Use: Called after every successful deallocation.
+
+        Arguments: memoryManager - the memory manager after the deallocation.
+
+        Returns: true if the memory should be compacted now. In incremental
+        mode this is always false, and a compaction is started instead.
+        ***************************************************************/
+        template <typename Manager>
+        bool afterDeallocation(const Manager& memoryManager)
+        {
+            if (mode == Incremental) 
+            {
+                if (!compacting && worthCompacting(memoryManager)) 
+                {
+                    compacting = true;
+                    compactionBytesLeft = memoryManager.allocatedMemory() - memoryManager.placementPolicy().lowestFreeAddress();
+                    deallocationsSinceCompaction = 0;
+                }
+                return false;
+            }
+            return worthCompacting(memoryManager);
+        }
+
+        // True while an incremental compaction is in progress, so a step should run after this transaction
+        bool stepPending() const { return compacting; }
+
+        // Called after every compaction step with what it moved
+        void stepped(const CompactionResult& step)
+        {
+            compactionBytesLeft -= step.bytesMoved;
+            if (step.blocksMoved == 0 || compactionBytesLeft <= 0) 
+            {
+                compacting = false;
+            }
+        }
+    private:
+        // The fixed and adaptive decision, counting this deallocation
+        template <typename Manager>
+        bool worthCompacting(const Manager& memoryManager)
+        {
+            if (++deallocationsSinceCompaction < k) 
+            {
+                return false;
+            }
+            if (mode == Fixed) 
+            {
+                deallocationsSinceCompaction = 0;
+                return true;
+            }
+            const auto& placement = memoryManager.placementPolicy();
+            long long freeMemory = memoryManager.freeMemory();
+            if (freeMemory == 0 || placement.freeBlockCount() < 2) 
+            {
+                return false;
+            }
+            long long largestFreeBlock = placement.largestFreeBlock();
+            double fragmentation = 1.0 - static_cast<double>(largestFreeBlock) / freeMemory;
+            if (fragmentation < threshold) 
+            {
+                return false;
+            }
+            long long relocationCost = memoryManager.allocatedMemory() - placement.lowestFreeAddress();
+            long long benefit = freeMemory - largestFreeBlock;
+            return benefit >= costWeight * relocationCost;
+        }
+    public:
+
+        /***************************************************************
+        Function: compactionCanHelp
+
+        Use: Called when an allocation has failed.
+
+        Arguments: 1. memoryManager: the memory manager.
+                   2. size: the requested size.
+
+        Returns: true if the memory should be compacted before retrying.
+        ***************************************************************/
+        template <typename Manager>
+        bool compactionCanHelp(const Manager& memoryManager, long long size) const
+        {
+            return mode == Fixed || (size <= memoryManager.freeMemory() && memoryManager.placementPolicy().blockSize(size) <= memoryManager.freeMemory());
+        }
+
+        // Called after every compaction, scheduled or not
+        void compacted()
+        {
+            if (mode == Adaptive) 
+            {
+                deallocationsSinceCompaction = 0;
+            }
+        }
+};
+
+/***************************************************************
+Struct: ReplayState
+
+Use: Carries the settings and running counters of a trace replay
+between transactions.
+***************************************************************/
+struct ReplayState
+{
+    long long totalMemorySize;
+    DefragmentationScheduler scheduler;
+    bool inBatch = false; // Between a batch and its end
+    vector<Transaction> batch; // The transactions collected since batch
+
+    ReplayState(long long totalMemorySize, const DefragmentationScheduler& scheduler) : totalMemorySize(totalMemorySize), scheduler(scheduler) {}
+};
+
+/***************************************************************
+Function: compactMemory
+
+Use: Runs unfragment, tells the scheduler and reports what was moved.
+
+Arguments: 1. memoryManager: the memory manager to compact.
+           2. state: the replay state to update.
+           3. outputFile: the output sink for the report.
+           4. fitSize: the size of a failed allocation, or 0. In incremental
+           mode the memory is then only compacted until it fits.
+
+Returns: Nothing.
+***************************************************************/
+template <typename Manager>
+void compactMemory(Manager& memoryManager, ReplayState& state, OutputSink& outputFile, long long fitSize = 0)
+{
+    CompactionResult compaction;
+    if (fitSize > 0 && state.scheduler.incremental()) 
+    {
+        compaction = memoryManager.compactToFit(fitSize, state.scheduler.fitByteBudget());
+    }
+    else 
+    {
+        compaction = memoryManager.unfragment(state.totalMemorySize);
+        state.scheduler.compacted();
+    }
+    outputFile.message(OutputSink::Summary).field("bytesMoved", compaction.bytesMoved).field("blocksMoved", compaction.blocksMoved)
+              << "Compaction moved " << compaction.bytesMoved << " bytes in " << compaction.blocksMoved << " blocks.\n";
+}
+
+/***************************************************************
+Function: reportAllocation
+
+Use: Writes the result of an allocation, and on a failure for lack of
+contiguous space compacts and retries it once.
+
+Arguments: 1. size: the requested size.
+           2. variableName: the variable to allocate.
+           3. startAddress: what allocateMemory or allocateBatch returned for it.
+           4. memoryManager: the memory manager.
+           5. state: the replay state.
+           6. outputFile: the output sink for messages.
+
+Returns: Nothing.
+***************************************************************/
+template <typename Manager>
+void reportAllocation(long long size, string_view variableName, long long startAddress, Manager& memoryManager, ReplayState& state, OutputSink& outputFile)
+{
+    if (startAddress >= 0 ) 
+    {
+        outputFile.message(OutputSink::Full).field("name", variableName).field("size", size).field("address", startAddress)
+                  << "Allocated " << size << " bytes for variable " << variableName << " at address " << startAddress << "\n";
+    } else if (startAddress == -2 && !state.scheduler.compactionCanHelp(memoryManager, size))
+    {
+        outputFile.message(OutputSink::Errors).field("name", variableName).field("size", size).field("free", memoryManager.freeMemory())
+                  << "Error: Not enough memory for allocation, only " << memoryManager.freeMemory() << " bytes are free in total.\n";
+    }
+    else if (startAddress == -2)
+    {
+        outputFile.message(OutputSink::Full).field("name", variableName).field("size", size)
+                  << (state.scheduler.incremental() ? "Not enough memory for allocation as of now. Trying after compacting just enough for it to fit.\n\n"
+                                                    : "Not enough memory for allocation as of now. Trying after eliminating any present fragmentation.\n\n");
+        compactMemory(memoryManager, state, outputFile, size);
+        startAddress=memoryManager.allocateMemory(size, variableName, outputFile);
+        if (startAddress >= 0 ) 
+        {
+            outputFile.message(OutputSink::Full).field("name", variableName).field("size", size).field("address", startAddress)
+                      << "Allocated " << size << " bytes for variable " << variableName << " at address " << startAddress << "\n";
+        }
+        else
+            outputFile.message(OutputSink::Errors).field("name", variableName).field("size", size) << "Error: Still not enough memory for allocation.\n";
+    }
+    else if (startAddress == -1)
+    {
+        outputFile.message(OutputSink::Errors).field("name", variableName) << "A variable with the same name as '" << variableName << "' is already present.\nDeallocate it or change the current variable name to something else.\n";
+    }
+}
+
+/***************************************************************
+Function: reportDeallocation
+
+Use: Writes that a variable's block was freed and lets the scheduler
+decide whether to compact.
+
+Arguments: 1. variableName: the variable that was freed.
+           2. memoryManager: the memory manager.
+           3. state: the replay state.
+           4. outputFile: the output sink for messages.
+
+Returns: Nothing.
+***************************************************************/
+template <typename Manager>
+void reportDeallocation(string_view variableName, Manager& memoryManager, ReplayState& state, OutputSink& outputFile)
+{
+    outputFile.message(OutputSink::Full).field("name", variableName) << "Deallocated memory for variable " << variableName << "\n";
+    if(state.scheduler.afterDeallocation(memoryManager))
+    {
+        compactMemory(memoryManager, state, outputFile);
+    }
+}
+
+/***************************************************************
+Function: finishTransaction
+
+Use: Runs one step of an incremental compaction in progress, after a
+transaction.
+
+Arguments: 1. memoryManager: the memory manager.
+           2. state: the replay state.
+           3. outputFile: the output sink for messages.
+
+Returns: Nothing.
+***************************************************************/
+template <typename Manager>
+void finishTransaction(Manager& memoryManager, ReplayState& state, OutputSink& outputFile)
+{
+    if (state.scheduler.stepPending()) 
+    {
+        CompactionResult step = memoryManager.compactStep(state.scheduler.stepBudget());
+        state.scheduler.stepped(step);
+        if (step.blocksMoved > 0) 
+        {
+            outputFile.message(OutputSink::Full).field("bytesMoved", step.bytesMoved).field("blocksMoved", step.blocksMoved)
+                      << "Compaction step moved " << step.bytesMoved << " bytes in " << step.blocksMoved << " blocks.\n";
+        }
+    }
+}
+
+template <typename Manager>
+void executeTransaction(const Transaction& transaction, Manager& memoryManager, ReplayState& state, OutputSink& outputFile);
+
+/***************************************************************
+Function: executeBatch
+
+Use: Applies the transactions collected between batch and end.
+
+Arguments: 1. memoryManager: the memory manager to apply them to.
+           2. state: the replay state, whose batch holds the transactions.
+           3. outputFile: the output sink for messages.
+
+Returns: Nothing.
+
+Notes: Every run of consecutive allocations goes to allocateBatch and
+every run of consecutive frees to freeBatch; anything else is executed
+on its own. The results are then written transaction by transaction,
+with the same messages, failed allocation retries, scheduling and
+compaction steps as outside a batch, so only the addresses and the
+free space can differ.
+***************************************************************/
+template <typename Manager>
+void executeBatch(Manager& memoryManager, ReplayState& state, OutputSink& outputFile)
+{
+    vector<Transaction> batch;
+    swap(batch, state.batch);
+    vector<AllocationRequest> requests;
+    vector<string_view> variableNames;
+    vector<typename Manager::AddressType> addresses;
+    vector<int> results;
+    size_t runStart = 0;
+    while (runStart < batch.size()) 
+    {
+        Transaction::Type type = batch[runStart].type;
+        size_t runEnd = runStart;
+        while (runEnd < batch.size() && batch[runEnd].type == type) 
+        {
+            runEnd++;
+        }
+        if (type == Transaction::Allocate) 
+        {
+            requests.clear();
+            for (size_t i = runStart; i < runEnd; ++i) 
+            {
+                requests.push_back({batch[i].size, batch[i].first});
+            }
+            memoryManager.allocateBatch(requests, addresses);
+            for (size_t i = runStart; i < runEnd; ++i) 
+            {
+                outputFile.beginTransaction("allocate");
+                long long address = addresses[i - runStart];
+                if (address == -3) 
+                {
+                    Manager::reportInvalidAllocation(batch[i].size, batch[i].first, outputFile);
+                }
+                else 
+                {
+                    reportAllocation(batch[i].size, batch[i].first, address, memoryManager, state, outputFile);
+                }
+                finishTransaction(memoryManager, state, outputFile);
+            }
+        }
+        else if (type == Transaction::Free) 
+        {
+            variableNames.clear();
+            for (size_t i = runStart; i < runEnd; ++i) 
+            {
+                variableNames.push_back(batch[i].first);
+            }
+            memoryManager.freeBatch(variableNames, results);
+            for (size_t i = runStart; i < runEnd; ++i) 
+            {
+                outputFile.beginTransaction("free");
+                int result = results[i - runStart];
+                if (result == 0) 
+                {
+                    reportDeallocation(batch[i].first, memoryManager, state, outputFile);
+                }
+                else 
+                {
+                    Manager::reportUnfinishedFree(batch[i].first, result, outputFile);
+                }
+                finishTransaction(memoryManager, state, outputFile);
+            }
+        }
+        else 
+        {
+            for (size_t i = runStart; i < runEnd; ++i) 
+            {
+                executeTransaction(batch[i], memoryManager, state, outputFile);
+            }
+        }
+        runStart = runEnd;
+    }
+}
+
+/***************************************************************
+Function: executeTransaction
+
+Use: Applies one parsed transaction to the memory manager.
+
+Arguments: 1. transaction: the transaction, as returned by parseTransaction.
+           2. memoryManager: the memory manager to apply it to.
+           3. state: the replay state, used for periodic compaction.
+           4. outputFile: the output sink for messages.
+
+Returns: Nothing.
+
+Notes: The defragmentation scheduler in the replay state decides when
+to compact: after a successful deallocation, and when an allocation
+fails, in which case the allocation is retried once after compacting.
+While an incremental compaction is in progress, one compaction step
+runs at the end of every transaction. Transactions between batch and
+end are collected and run by executeBatch when end is reached, and
+their messages are numbered as if they had run in place.
+***************************************************************/
+template <typename Manager>
+void executeTransaction(const Transaction& transaction, Manager& memoryManager, ReplayState& state, OutputSink& outputFile)
+{
+    if (state.inBatch && transaction.type != Transaction::Batch && transaction.type != Transaction::BatchEnd) 
+    {
+        state.batch.push_back(transaction);
+        return;
+    }
+    bool endsBatch = transaction.type == Transaction::BatchEnd && state.inBatch;
+    if (endsBatch) 
+    {
+        state.inBatch = false;
+        executeBatch(memoryManager, state, outputFile);
+    }
+
+    static const char* transactionTypes[] = {"allocate", "free", "reference", "print", "check", "stats", "print summary", "print delta", "batch", "end", "unknown"};
+    outputFile.beginTransaction(transactionTypes[transaction.type]);
+
+    if (transaction.type == Transaction::Allocate)
+    {
+        reportAllocation(transaction.size, transaction.first, memoryManager.allocateMemory(transaction.size, transaction.first, outputFile), memoryManager, state, outputFile);
+    } 
+    else if (transaction.type == Transaction::Free) 
+    {
+        string_view variableName = transaction.first;
+        int status = memoryManager.deallocateMemory(variableName,outputFile);
+        if(status >= 0)
+        {
+            reportDeallocation(variableName, memoryManager, state, outputFile);
+        }
+    } 
+    else if (transaction.type == Transaction::Print) 
+    {
+        memoryManager.printMemoryState(outputFile);
+    }
+    else if (transaction.type == Transaction::Check) 
+    {
+        memoryManager.verifyMemoryState(outputFile);
+    }
+    else if (transaction.type == Transaction::Stats) 
+    {
+        memoryManager.printStatistics(outputFile);
+    }
+    else if (transaction.type == Transaction::PrintSummary) 
+    {
+        memoryManager.printMemorySummary(outputFile);
+    }
+    else if (transaction.type == Transaction::PrintDelta) 
+    {
+        memoryManager.printMemoryDelta(outputFile);
+    }
+    else if (transaction.type == Transaction::Reference) 
+    {
+        string_view var1 = transaction.first, var2 = transaction.second;
+        int flag=memoryManager.referenceMemory(var1, var2);
+        if (flag==1) 
+        {
+            outputFile.message(OutputSink::Full).field("name", var1).field("target", var2) << "Reference: " << var1 << " is now referring to the same block as " << var2 << "\n";
+        } 
+        else if(flag==0)
+        {
+            outputFile.message(OutputSink::Errors).field("name", var1).field("target", var2) << "Error: " << var2 << " does not refer to any block.\n\n";
+        } 
+        else
+        {
+            outputFile.message(OutputSink::Errors).field("name", var1).field("target", var2) << "Error: " << var1 << " already refers to a block.\n\n";
+        }
+    }
+    else if (transaction.type == Transaction::Batch) 
+    {
+        if (state.inBatch) 
+        {
+            outputFile.message(OutputSink::Errors) << "Error: A batch cannot start inside another batch.\n";
+        }
+        state.inBatch = true;
+    }
+    else if (transaction.type == Transaction::BatchEnd) 
+    {
+        if (!endsBatch) 
+        {
+            outputFile.message(OutputSink::Errors) << "Error: end without a batch.\n";
+        }
+    }
+    else 
+    {
+        outputFile.message(OutputSink::Errors) << "Error: Unknown transaction type.\n";
+    }
+
+    finishTransaction(memoryManager, state, outputFile);
+}
+
+/***************************************************************
+Function: finishBatch
+
+Use: Runs a batch that the trace left open at its end, as if the
+end had been there.
+
+Arguments: 1. memoryManager: the memory manager.
+           2. state: the replay state.
+           3. outputFile: the output sink for messages.
+
+Returns: Nothing.
+***************************************************************/
+template <typename Manager>
+void finishBatch(Manager& memoryManager, ReplayState& state, OutputSink& outputFile)
+{
+    if (state.inBatch) 
+    {
+        state.inBatch = false;
+        executeBatch(memoryManager, state, outputFile);
+    }
+}
+
+/***************************************************************
+Function: replayTrace
+
+Use: Replays a whole trace, either on this thread or pipelined over
+three threads.
+
+Arguments: 1. readBatch: appends up to replayBatchSize decoded transactions
+           to a batch, and returns false once the trace has no more.
+           2. memoryManager: the memory manager to apply them to.
+           3. state: the replay state.
+           4. outputFile: the output sink for messages.
+           5. pipelined: true to parse, execute and write on separate threads.
+
+Returns: Nothing.
+
+Notes: The pipelined replay runs readBatch on a parser thread and
+passes the batches to this thread through an SpscRing. This thread
+executes them in order, and the output sink hands every full buffer
+to a writer thread through a second ring, which writes it to the
+file. The transactions run in the same order on the same manager and
+the buffers are written in the order they were filled, so the output
+is byte for byte the same as the serial replay's. The messages are
+still formatted here, because the memory manager formats them as it
+goes. The names in the transactions must stay valid until the replay
+ends, which holds for the mapped text trace and for the binary trace
+reader's interned names.
+***************************************************************/
+template <typename Manager>
+void replayTrace(const function<bool(vector<Transaction>&)>& readBatch, Manager& memoryManager, ReplayState& state, OutputSink& outputFile, bool pipelined)
+{
+    if (!pipelined) 
+    {
+        vector<Transaction> batch;
+        batch.reserve(replayBatchSize);
+        bool more = true;
+        while (more) 
+        {
+            batch.clear();
+            more = readBatch(batch);
+            for (const Transaction& transaction : batch) 
+            {
+                executeTransaction(transaction, memoryManager, state, outputFile);
+            }
+        }
+        finishBatch(memoryManager, state, outputFile);
+        return;
+    }
+
+    SpscRing<vector<Transaction>> parsed(16);
+    SpscRing<string> written(8);
+    thread parser([&]
+    {
+        bool more = true;
+        while (more) 
+        {
+            vector<Transaction> batch;
+            batch.reserve(replayBatchSize);
+            more = readBatch(batch);
+            if (!batch.empty()) 
+            {
+                parsed.push(std::move(batch));
+            }
+        }
+        parsed.close();
+    });
+    thread writer([&]
+    {
+        string chunk;
+        while (written.pop(chunk)) 
+        {
+            outputFile.write(chunk);
+        }
+    });
+    outputFile.setWriter([&](string& full)
+    {
+        string fresh;
+        fresh.reserve(full.capacity());
+        swap(fresh, full);
+        written.push(std::move(fresh));
+    });
+
+    vector<Transaction> batch;
+    while (parsed.pop(batch)) 
+    {
+        for (const Transaction& transaction : batch) 
+        {
+            executeTransaction(transaction, memoryManager, state, outputFile);
+        }
+    }
+    finishBatch(memoryManager, state, outputFile);
+    outputFile.flush();
+    written.close();
+    parser.join();
+    writer.join();
+    outputFile.setWriter(nullptr);
+}
+
+/***************************************************************
+Struct: WorkloadConfig
+
+Use: Parameters of a synthetic trace for the benchmark.
+
+Notes: sizeDistribution is uniform, zipf (small sizes much more
+likely, exponent 1.1) or bimodal (90% small, 10% large).
+lifetimeDistribution is exponential, uniform or fixed, and
+meanLifetime is measured in transactions.
+***************************************************************/
+struct WorkloadConfig
+{
+    long long transactions = 1000000;
+    long long heapSize = 1 << 24;
+    string sizeDistribution = "uniform";
+    int minSize = 16,
+        maxSize = 4096;
+    string lifetimeDistribution = "exponential";
+    double meanLifetime = 1000;
+    double referenceRatio = 0.05;
+    double printRatio = 0;
+    unsigned seed = 1;
+};
+
+/***************************************************************
+Function: generateWorkload
+
+Use: Generates a synthetic trace in the transaction language.
+
+Arguments: config - the workload parameters.
+
+Returns: The trace, one transaction per element.
+
+Notes: Every allocation and reference gets a death time drawn from
+the lifetime distribution. At each step the generator frees the
+variable whose death time has passed first, if there is one, and
+otherwise allocates or adds a reference. Names are v<n> for
+allocations and r<n> for references. The same config and seed
+always give the same trace.
+***************************************************************/
+vector<string> generateWorkload(const WorkloadConfig& config)
+{
+    mt19937_64 random(config.seed);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    int span = config.maxSize - config.minSize;
+
+    // Zipf over up to 65536 size ranks, rank 1 being minSize
+    int zipfRanks = min(span + 1, 1 << 16);
+    vector<double> zipfWeights(zipfRanks);
+    for (int rank = 0; rank < zipfRanks; ++rank) 
+    {
+        zipfWeights[rank] = 1.0 / pow(rank + 1.0, 1.1);
+    }
+    discrete_distribution<int> zipf(zipfWeights.begin(), zipfWeights.end());
+
+    auto drawSize = [&]() -> int
+    {
+        if (config.sizeDistribution == "zipf") 
+        {
+            int rank = zipf(random);
+            return config.minSize + (zipfRanks > 1 ? static_cast<int>(static_cast<long long>(rank) * span / (zipfRanks - 1)) : 0);
+        }
+        if (config.sizeDistribution == "bimodal") 
+        {
+            if (unit(random) < 0.9) 
+            {
+                return uniform_int_distribution<int>(config.minSize, config.minSize + span / 16)(random);
+            }
+            return uniform_int_distribution<int>(config.maxSize - span / 4, config.maxSize)(random);
+        }
+        return uniform_int_distribution<int>(config.minSize, config.maxSize)(random);
+    };
+    auto drawLifetime = [&]() -> long long
+    {
+        double lifetime = config.meanLifetime;
+        if (config.lifetimeDistribution == "exponential") 
+        {
+            lifetime = exponential_distribution<double>(1.0 / config.meanLifetime)(random);
+        }
+        else if (config.lifetimeDistribution == "uniform") 
+        {
+            lifetime = uniform_real_distribution<double>(1.0, 2.0 * config.meanLifetime)(random);
+        }
+        return max(1LL, static_cast<long long>(lifetime));
+    };
+
+    vector<string> trace;
+    trace.reserve(config.transactions);
+    priority_queue<pair<long long, string>, vector<pair<long long, string>>, greater<>> deaths;
+    vector<string> live; // allocated variables that a reference can point at
+    unordered_map<string, size_t> liveIndex;
+    long long nextId = 0;
+
+    for (long long step = 0; step < config.transactions; ++step) 
+    {
+        double choice = unit(random);
+        if (choice < config.printRatio) 
+        {
+            trace.push_back("print");
+        }
+        else if (!deaths.empty() && deaths.top().first <= step) 
+        {
+            string name = deaths.top().second;
+            deaths.pop();
+            auto indexIt = liveIndex.find(name);
+            if (indexIt != liveIndex.end()) 
+            {
+                live[indexIt->second] = live.back();
+                liveIndex[live.back()] = indexIt->second;
+                live.pop_back();
+                liveIndex.erase(name);
+            }
+            trace.push_back("free " + name);
+        }
+        else if (choice < config.printRatio + config.referenceRatio && !live.empty()) 
+        {
+            string target = live[uniform_int_distribution<size_t>(0, live.size() - 1)(random)];
+            string name = "r" + to_string(nextId++);
+            deaths.push({step + drawLifetime(), name});
+            trace.push_back("reference " + name + " " + target);
+        }
+        else 
+        {
+            string name = "v" + to_string(nextId++);
+            deaths.push({step + drawLifetime(), name});
+            liveIndex[name] = live.size();
+            live.push_back(name);
+            trace.push_back("allocate " + to_string(drawSize()) + " " + name);
+        }
+    }
+    return trace;
+}
+
+/***************************************************************
+Function: readOption
+
+Use: Matches a "--name=value" command line argument.
+
+Arguments: 1. argument: the command line argument.
+           2. name: the option name, without the leading dashes.
+           3. value: receives the value if the name matches.
+
+Returns: true if the argument is the named option.
+***************************************************************/
+bool readOption(const string& argument, const string& name, string& value)
+{
+    string prefix = "--" + name + "=";
+    if (argument.rfind(prefix, 0) != 0) 
+    {
+        return false;
+    }
+    value = argument.substr(prefix.size());
+    return true;
+}
+
+/***************************************************************
+Function: peakResidentKilobytes
+
+Use: Reports the peak resident set size of the process.
+
+Arguments: None.
+
+Returns: The peak RSS in kilobytes, or -1 where it is not available.
+***************************************************************/
+long peakResidentKilobytes()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+/***************************************************************
+Struct: DefragmentationOptions
+
+Use: The scheduler settings read from the command line.
+***************************************************************/
+struct DefragmentationOptions
+{
+    string mode = "adaptive";
+    double threshold = 0.5,
+           costWeight = 0.5;
+    CompactionBudget step = {1 << 16, 256, chrono::nanoseconds(0)};
+    int fitBudget = 1 << 20;
+};
+
+/***************************************************************
+Function: readDefragmentationOption
+
+Use: Reads one of the scheduler options --defrag=fixed|adaptive|incremental,
+--defrag-threshold, --defrag-cost, --defrag-step-bytes,
+--defrag-step-blocks, --defrag-step-time (microseconds) and
+--defrag-fit-budget.
+
+Arguments: 1. argument: the command-line argument.
+           2. options: set from the argument.
+
+Returns: true if the argument was a scheduler option.
+***************************************************************/
+bool readDefragmentationOption(const string& argument, DefragmentationOptions& options)
+{
+    string value;
+    if (readOption(argument, "defrag", options.mode)) return true;
+    if (readOption(argument, "defrag-threshold", value)) options.threshold = stod(value);
+    else if (readOption(argument, "defrag-cost", value)) options.costWeight = stod(value);
+    else if (readOption(argument, "defrag-step-bytes", value)) options.step.bytes = stoi(value);
+    else if (readOption(argument, "defrag-step-blocks", value)) options.step.blocks = stoi(value);
+    else if (readOption(argument, "defrag-step-time", value)) options.step.time = chrono::microseconds(stoll(value));
+    else if (readOption(argument, "defrag-fit-budget", value)) options.fitBudget = stoi(value);
+    else return false;
+    return true;
+}
+
+/***************************************************************
+Function: makeDefragmentationScheduler
+
+Use: Checks the scheduler options and builds the scheduler.
+
+Arguments: 1. options: the scheduler settings.
+           2. k: the minimum number of deallocations between compactions.
+           3. scheduler: set to the new scheduler.
+
+Returns: false and prints an error if an option is invalid.
+***************************************************************/
+bool makeDefragmentationScheduler(const DefragmentationOptions& options, int k, DefragmentationScheduler& scheduler)
+{
+    if (options.mode != "fixed" && options.mode != "adaptive" && options.mode != "incremental") 
+    {
+        cerr << "Unknown defragmentation mode " << options.mode << ". Use fixed, adaptive or incremental.\n";
+        return false;
+    }
+    if (options.threshold < 0 || options.threshold > 1 || options.costWeight < 0) 
+    {
+        cerr << "The defragmentation threshold must be between 0 and 1 and the cost weight must not be negative.\n";
+        return false;
+    }
+    if (options.step.bytes < 0 || options.step.blocks < 0 || options.step.time.count() < 0 || options.fitBudget < 0) 
+    {
+        cerr << "The compaction step and fit budgets must not be negative.\n";
+        return false;
+    }
+    DefragmentationScheduler::Mode mode = options.mode == "fixed" ? DefragmentationScheduler::Fixed
+                                          : options.mode == "adaptive" ? DefragmentationScheduler::Adaptive : DefragmentationScheduler::Incremental;
+    scheduler = DefragmentationScheduler(mode, k, options.threshold, options.costWeight, options.step, options.fitBudget);
+    return true;
+}
+
+/***************************************************************
+Function: checkSlabMaxSize
+
+Use: Checks the --slab-max-size option against the slab cache's
+limit and the heap.
+
+Arguments: 1. size: the largest size served from slabs, 0 for none.
+           2. heapSize: the size of the heap in bytes.
+
+Returns: false and prints an error if the size cannot be used.
+
+Notes: A slab of the largest class holds SlabCache::slotsPerSlab
+slots, so it must fit in the heap with room to spare.
+***************************************************************/
+bool checkSlabMaxSize(int size, long long heapSize)
+{
+    constexpr int largest = SlabCache<int>::largestSlotSize;
+    if (size < 0 || size > largest) 
+    {
+        cerr << "The slab max size must be between 0 and " << largest << ".\n";
+        return false;
+    }
+    long long slotSize = (size + SlabCache<int>::classGranularity - 1) / SlabCache<int>::classGranularity * SlabCache<int>::classGranularity;
+    if (slotSize * SlabCache<int>::slotsPerSlab > heapSize / 2) 
+    {
+        cerr << "A slab of " << slotSize * SlabCache<int>::slotsPerSlab << " bytes for blocks of " << size << " bytes would take more than half the heap. Use a smaller slab max size.\n";
+        return false;
+    }
+    return true;
+}
+
+/***************************************************************
+Struct: HeapModel
+
+Use: The address width and occupancy record of the memory manager,
+read from the command line.
+***************************************************************/
+struct HeapModel
+{
+    int addressBits = 0; // 32 or 64, 0 to take 64 only when the heap does not fit in an int
+    bool extentOnly = false; // Record allocated extents instead of a bit per byte, see ExtentMap
+};
+
+/***************************************************************
+Function: readHeapModelOption
+
+Use: Reads one of the heap model options --address-bits=32|64 and
+--extent-only.
+
+Arguments: 1. argument: the command-line argument.
+           2. model: set from the argument.
+
+Returns: true if the argument was a heap model option.
+***************************************************************/
+bool readHeapModelOption(const string& argument, HeapModel& model)
+{
+    string value;
+    if (argument == "--extent-only") model.extentOnly = true;
+    else if (readOption(argument, "address-bits", value)) model.addressBits = stoi(value);
+    else return false;
+    return true;
+}
+
+/***************************************************************
+Function: checkHeapModel
+
+Use: Picks the address width if none was given and checks that the
+heap model fits the heap.
+
+Arguments: 1. model: the heap model, whose addressBits is filled in.
+           2. heapSize: the size of the heap in bytes.
+           3. ownsArena: true if the heap is backed by a real buffer.
+
+Returns: false and prints an error if the model cannot be used.
+***************************************************************/
+bool checkHeapModel(HeapModel& model, long long heapSize, bool ownsArena)
+{
+    if (model.addressBits == 0) 
+    {
+        model.addressBits = heapSize > numeric_limits<int>::max() ? 64 : 32;
+    }
+    if (model.addressBits != 32 && model.addressBits != 64) 
+    {
+        cerr << "Address bits must be 32 or 64.\n";
+        return false;
+    }
+    if (model.addressBits == 32 && heapSize > numeric_limits<int>::max()) 
+    {
+        cerr << "A heap of more than " << numeric_limits<int>::max() << " bytes needs --address-bits=64.\n";
+        return false;
+    }
+    if (model.extentOnly && ownsArena) 
+    {
+        cerr << "--arena keeps every byte of the heap in memory, so it cannot be combined with --extent-only.\n";
+        return false;
+    }
+    return true;
+}
+
+// Builds a MemoryManager<Address, Occupancy> of size bytes and runs visit on it
+template <typename Address, typename Occupancy, typename Visit>
+int visitMemoryManager(long long size, const string& policyName, bool ownsArena, Visit& visit)
+{
+    MemoryManager<Address, Occupancy> memoryManager(static_cast<Address>(size), makePlacementPolicy<Address>(policyName), ownsArena);
+    return visit(memoryManager);
+}
+
+/***************************************************************
+Function: withMemoryManager
+
+Use: Builds the memory manager a heap model asks for and runs visit
+on it.
+
+Arguments: 1. model: the checked heap model.
+           2. size: the size of the heap in bytes.
+           3. policyName: a valid placement policy name.
+           4. ownsArena: true to back the heap with a real buffer.
+           5. visit: called with the manager, so it must take any
+              MemoryManager type, as a generic lambda does.
+
+Returns: What visit returns.
+***************************************************************/
+template <typename Visit>
+int withMemoryManager(const HeapModel& model, long long size, const string& policyName, bool ownsArena, Visit visit)
+{
+    if (model.addressBits == 64) 
+    {
+        return model.extentOnly ? visitMemoryManager<int64_t, ExtentMap<int64_t>>(size, policyName, ownsArena, visit)
+                                : visitMemoryManager<int64_t, OccupancyBitmap<int64_t>>(size, policyName, ownsArena, visit);
+    }
+    return model.extentOnly ? visitMemoryManager<int, ExtentMap<int>>(size, policyName, ownsArena, visit)
+                            : visitMemoryManager<int, OccupancyBitmap<int>>(size, policyName, ownsArena, visit);
+}
+
+/***************************************************************
+Function: runBenchmark
+
+Use: Generates a synthetic workload, replays it through a
+MemoryManager and reports throughput and allocator statistics.
+
+Arguments: 1. argc: the argument count from main.
+           2. argv: the arguments from main, argv[1] being "bench".
+
+Returns: 0 on success, 1 on a bad option.
+
+Notes: Options are --transactions, --heap, --sizes, --min-size,
+--max-size, --lifetime, --mean-lifetime, --reference-ratio,
+--print-ratio, --seed, --policy, --interval (minimum number of frees
+between compactions, as k in the normal mode), the --defrag options
+(see readDefragmentationOption), --trace-out, which also writes the
+generated trace to a file so it can be replayed in the normal mode or
+by another build, --stats, which writes the memory manager's
+statistics to a file after the replay, --arena, which backs the
+heap with a real buffer so compaction moves the payloads and the
+report includes the compaction bandwidth, --compaction-threads,
+--slab-max-size and the heap model options --address-bits and
+--extent-only (see readHeapModelOption).
+With more than one compaction thread the trace is replayed a second
+time with serial compaction, and the pause times and final layouts
+of the two runs are compared; in an arena every new block is filled
+with a pattern from its handle first, so the payloads are compared
+too. Each transaction is timed individually, including parsing, and
+the output messages are discarded.
+***************************************************************/
+int runBenchmark(int argc, char* argv[])
+{
+    WorkloadConfig config;
+    string policyName = "best", traceOut, statsOut, value;
+    DefragmentationOptions defragmentation;
+    HeapModel heapModel;
+    bool ownsArena = false;
+    int k = 1,
+        compactionThreads = 1,
+        slabMaxSize = 0;
+    for (int i = 2; i < argc; ++i) 
+    {
+        string argument = argv[i];
+        if (readOption(argument, "transactions", value)) config.transactions = stoll(value);
+        else if (readOption(argument, "heap", value)) config.heapSize = stoll(value);
+        else if (readOption(argument, "sizes", value)) config.sizeDistribution = value;
+        else if (readOption(argument, "min-size", value)) config.minSize = stoi(value);
+        else if (readOption(argument, "max-size", value)) config.maxSize = stoi(value);
+        else if (readOption(argument, "lifetime", value)) config.lifetimeDistribution = value;
+        else if (readOption(argument, "mean-lifetime", value)) config.meanLifetime = stod(value);
+        else if (readOption(argument, "reference-ratio", value)) config.referenceRatio = stod(value);
+        else if (readOption(argument, "print-ratio", value)) config.printRatio = stod(value);
+        else if (readOption(argument, "seed", value)) config.seed = stoul(value);
+        else if (readOption(argument, "policy", value)) policyName = value;
+        else if (readOption(argument, "interval", value)) k = stoi(value);
+        else if (readOption(argument, "trace-out", value)) traceOut = value;
+        else if (readOption(argument, "stats", value)) statsOut = value;
+        else if (readDefragmentationOption(argument, defragmentation)) continue;
+        else if (readHeapModelOption(argument, heapModel)) continue;
+        else if (argument == "--arena") ownsArena = true;
+        else if (readOption(argument, "compaction-threads", value)) compactionThreads = stoi(value);
+        else if (readOption(argument, "slab-max-size", value)) slabMaxSize = stoi(value);
+        else 
+        {
+            cerr << "Unknown benchmark option " << argument << "\n";
+            return 1;
+        }
+    }
+    if (config.sizeDistribution != "uniform" && config.sizeDistribution != "zipf" && config.sizeDistribution != "bimodal") 
+    {
+        cerr << "Unknown size distribution " << config.sizeDistribution << ". Use uniform, zipf or bimodal.\n";
+        return 1;
+    }
+    if (config.lifetimeDistribution != "exponential" && config.lifetimeDistribution != "uniform" && config.lifetimeDistribution != "fixed") 
+    {
+        cerr << "Unknown lifetime distribution " << config.lifetimeDistribution << ". Use exponential, uniform or fixed.\n";
+        return 1;
+    }
+    if (config.heapSize < 1 || config.minSize < 1 || config.maxSize < config.minSize || k < 1 || config.meanLifetime <= 0) 
+    {
+        cerr << "Heap size, sizes, interval and mean lifetime must be positive, and max-size at least min-size.\n";
+        return 1;
+    }
+    if (compactionThreads < 1) 
+    {
+        cerr << "The number of compaction threads must be at least 1.\n";
+        return 1;
+    }
+    if (!makePlacementPolicy<int>(policyName)) 
+    {
+        cerr << "Unknown placement policy " << policyName << ". Use first, next, best, worst, tlsf or buddy.\n";
+        return 1;
+    }
+    DefragmentationScheduler scheduler(DefragmentationScheduler::Adaptive, k);
+    if (!makeDefragmentationScheduler(defragmentation, k, scheduler) || !checkHeapModel(heapModel, config.heapSize, ownsArena)
+        || !checkSlabMaxSize(slabMaxSize, config.heapSize)) 
+    {
+        return 1;
+    }
+
+    vector<string> trace = generateWorkload(config);
+    if (!traceOut.empty()) 
+    {
+        ofstream traceFile(traceOut);
+        for (const auto& line : trace) 
+        {
+            traceFile << line << "\n";
+        }
+    }
+
+    return withMemoryManager(heapModel, config.heapSize, policyName, ownsArena, [&](auto& memoryManager)
+    {
+        memoryManager.setCompactionThreads(compactionThreads);
+        memoryManager.setSlabMaxSize(slabMaxSize);
+        ReplayState state = {config.heapSize, scheduler};
+        OutputSink discard;
+        discard.open("", OutputSink::Silent, false);
+        vector<chrono::nanoseconds::rep> latencies;
+        latencies.reserve(trace.size());
+
+        // In an arena, every new block is filled with a pattern derived from its handle, so the
+        // layout comparison after a parallel run checks the payloads compaction moved
+        vector<char> pattern;
+        auto fillPayload = [&](auto& manager, const Transaction& transaction)
+        {
+            int handle = ownsArena && transaction.type == Transaction::Allocate ? manager.handleOf(transaction.first) : -1;
+            if (handle < 0) 
+            {
+                return;
+            }
+            pattern.resize(transaction.size);
+            for (size_t offset = 0; offset < pattern.size(); ++offset) 
+            {
+                pattern[offset] = static_cast<char>(handle * 131 + offset);
+            }
+            manager.writePayload(handle, 0, pattern.data(), transaction.size);
+        };
+
+        auto replayStart = chrono::steady_clock::now();
+        for (const auto& line : trace) 
+        {
+            auto transactionStart = chrono::steady_clock::now();
+            Transaction transaction = parseTransaction(line);
+            executeTransaction(transaction, memoryManager, state, discard);
+            latencies.push_back((chrono::steady_clock::now() - transactionStart).count());
+            fillPayload(memoryManager, transaction);
+        }
+        double replaySeconds = chrono::duration<double>(chrono::steady_clock::now() - replayStart).count();
+
+        sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double fraction) -> long long
+        {
+            return latencies.empty() ? 0 : latencies[min(latencies.size() - 1, static_cast<size_t>(fraction * latencies.size()))];
+        };
+
+        long long totalFree = 0,
+                  largestFree = 0;
+        auto freeBlocks = memoryManager.placementPolicy().freeBlockList();
+        for (const auto& block : freeBlocks) 
+        {
+            totalFree += block.size;
+            largestFree = max<long long>(largestFree, block.size);
+        }
+        double fragmentation = totalFree == 0 ? 0.0 : 1.0 - static_cast<double>(largestFree) / totalFree;
+
+        cout << "Policy: " << policyName << ", sizes: " << config.sizeDistribution << " [" << config.minSize << ", " << config.maxSize << "]"
+             << ", lifetime: " << config.lifetimeDistribution << " (mean " << config.meanLifetime << ")"
+             << ", heap: " << config.heapSize << " (" << heapModel.addressBits << "-bit" << (heapModel.extentOnly ? ", extent-only" : "") << ")"
+             << ", seed: " << config.seed << "\n";
+        cout << "Transactions: " << trace.size() << "\n";
+        cout << "Replay time: " << replaySeconds << " s\n";
+        cout << "Throughput: " << static_cast<long long>(replaySeconds > 0 ? trace.size() / replaySeconds : 0) << " ops/sec\n";
+        cout << "Latency p50: " << percentile(0.50) << " ns, p99: " << percentile(0.99) << " ns, max: " << (latencies.empty() ? 0 : latencies.back()) << " ns\n";
+        const OperationStatistics& compactions = memoryManager.operationStatistics().unfragment;
+        cout << "Compactions: " << compactions.calls << ", total time: " << compactions.latency.total() / 1e6 << " ms\n";
+        const OperationStatistics& steps = memoryManager.operationStatistics().compactStep;
+        const OperationStatistics& fits = memoryManager.operationStatistics().compactToFit;
+        if (steps.calls > 0 || fits.calls > 0) 
+        {
+            cout << "Compaction steps: " << steps.calls << ", total time: " << steps.latency.total() / 1e6 << " ms, max " << steps.latency.maximum() / 1e3 << " us\n";
+            cout << "Compactions to fit: " << fits.calls << ", total time: " << fits.latency.total() / 1e6 << " ms, max " << fits.latency.maximum() / 1e3 << " us\n";
+        }
+        long long compactionTime = compactions.latency.total() + steps.latency.total() + fits.latency.total();
+        if (ownsArena && compactionTime > 0) 
+        {
+            cout << "Compaction bandwidth: " << static_cast<double>(memoryManager.operationStatistics().bytesMoved) / compactionTime
+                 << " GB/s (" << memoryManager.operationStatistics().bytesMoved << " bytes moved)\n";
+        }
+        if (memoryManager.compactionThreads() > 1) 
+        {
+            // Replay the trace again with serial compaction to compare the pauses and the layout
+            using Manager = remove_reference_t<decltype(memoryManager)>;
+            Manager serialManager(config.heapSize, makePlacementPolicy<typename Manager::AddressType>(policyName), ownsArena);
+            serialManager.setSlabMaxSize(slabMaxSize);
+            ReplayState serialState = {config.heapSize, scheduler};
+            for (const auto& line : trace) 
+            {
+                Transaction transaction = parseTransaction(line);
+                executeTransaction(transaction, serialManager, serialState, discard);
+                fillPayload(serialManager, transaction);
+            }
+            const OperationStatistics& serialCompactions = serialManager.operationStatistics().unfragment;
+            cout << "Compaction pause with " << memoryManager.compactionThreads() << " threads: mean " << compactions.latency.mean() / 1e6
+                 << " ms, max " << compactions.latency.maximum() / 1e6 << " ms\n";
+            cout << "Compaction pause serial: mean " << serialCompactions.latency.mean() / 1e6 << " ms, max " << serialCompactions.latency.maximum() / 1e6 << " ms\n";
+            cout << "Layout matches serial compaction: " << (memoryManager.sameLayout(serialManager) ? "yes" : "no") << "\n";
+        }
+        if (memoryManager.slabs().enabled()) 
+        {
+            const SlabStatistics& slabCounters = memoryManager.slabs().statistics();
+            cout << "Slab hit rate: " << (slabCounters.requests == 0 ? 0.0 : static_cast<double>(slabCounters.hits) / slabCounters.requests) << " (" << slabCounters.hits
+                 << " of " << slabCounters.requests << " small allocations), slabs created: " << slabCounters.slabsCreated << ", returned: " << slabCounters.slabsReturned
+                 << ", fallbacks: " << slabCounters.fallbacks << "\n";
+            cout << "Slab overhead: " << memoryManager.slabs().reservedBytes() - memoryManager.slabs().heldBytes() << " bytes (" << memoryManager.slabs().slabCount()
+                 << " slabs holding " << memoryManager.slabs().heldBytes() << " of " << memoryManager.slabs().reservedBytes() << " bytes)\n";
+        }
+        cout << "Peak RSS: " << peakResidentKilobytes() << " KB\n";
+        cout << "Final fragmentation: " << fragmentation << " (largest free block " << largestFree << " of " << totalFree << " free bytes in " << freeBlocks.size() << " blocks)\n";
+        if (!statsOut.empty()) 
+        {
+            OutputSink statsFile;
+            if (!statsFile.open(statsOut, OutputSink::Summary, false)) 
+            {
+                cerr << "Error opening statistics file.\n";
+                return 1;
+            }
+            memoryManager.printStatistics(statsFile);
+        }
+        return 0;
+    });
+}
+
+/***************************************************************
+Function: runConcurrentRun
+
+Use: Runs one round of the concurrent benchmark.
+
+Arguments: 1. manager: the manager to drive, with one shard, or one per thread.
+           2. threads: the number of threads.
+           3. operations: the allocations and frees per thread.
+           4. config: heapSize, minSize, maxSize and seed of the workload.
+           5. live: the number of blocks each thread keeps alive.
+           6. handoff: the fraction of blocks freed by the next thread
+              instead of the one that allocated them.
+
+Returns: The operations per second over all threads, or -1 if the
+manager was not consistent or did not end empty.
+
+Notes: Each thread allocates until it holds live blocks and then
+alternates between freeing a random block and allocating a new one.
+Handed off blocks go through a LockFreeStack per thread, which the
+next thread empties every 64 operations, so they are freed from a
+different thread than the one that allocated them.
+***************************************************************/
+double runConcurrentRun(ShardedMemoryManager& manager, int threads, long long operations, const WorkloadConfig& config, int live, double handoff)
+{
+    vector<unique_ptr<LockFreeStack>> inboxes;
+    for (int index = 0; index < threads; ++index) 
+    {
+        inboxes.push_back(make_unique<LockFreeStack>());
+    }
+    atomic<bool> go{false};
+    auto worker = [&](int home)
+    {
+        mt19937 rng(config.seed + home);
+        uniform_int_distribution<int> sizes(config.minSize, config.maxSize);
+        uniform_real_distribution<double> unit(0.0, 1.0);
+        vector<int> blocks;
+        blocks.reserve(live);
+        LockFreeStack& next = *inboxes[(home + 1) % threads];
+        auto freeHandedOff = [&] { inboxes[home]->takeAll([&](int address) { manager.deallocate(home, address); }); };
+        while (!go.load(memory_order_acquire)) {}
+        for (long long operation = 0; operation < operations; ++operation) 
+        {
+            if (operation % 64 == 0) 
+            {
+                freeHandedOff();
+            }
+            if (static_cast<int>(blocks.size()) < live && (blocks.empty() || operation % 2 == 0)) 
+            {
+                int address = manager.allocate(home, sizes(rng));
+                if (address >= 0) 
+                {
+                    blocks.push_back(address);
+                }
+                continue;
+            }
+            size_t index = rng() % blocks.size();
+            int address = blocks[index];
+            blocks[index] = blocks.back();
+            blocks.pop_back();
+            if (threads > 1 && unit(rng) < handoff) 
+            {
+                next.push(address);
+            }
+            else 
+            {
+                manager.deallocate(home, address);
+            }
+        }
+        for (int address : blocks) 
+        {
+            manager.deallocate(home, address);
+        }
+    };
+
+    vector<thread> workers;
+    for (int home = 0; home < threads; ++home) 
+    {
+        workers.emplace_back(worker, home);
+    }
+    auto start = chrono::steady_clock::now();
+    go.store(true, memory_order_release);
+    for (auto& thread : workers) 
+    {
+        thread.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (int home = 0; home < threads; ++home) 
+    {
+        inboxes[home]->takeAll([&](int address) { manager.deallocate(home, address); });
+    }
+    if (!manager.consistent() || manager.allocatedMemory() != 0) 
+    {
+        return -1;
+    }
+    return threads * operations / seconds;
+}
+
+/***************************************************************
+Function: runConcurrentBenchmark
+
+Use: Measures how allocation throughput scales with the number of
+threads, for the sharded manager and for a single lock.
+
+Arguments: 1. argc: the argument count from main.
+           2. argv: the arguments from main, argv[1] being "mtbench".
+
+Returns: 0 on success, 1 on a bad option or a failed consistency check.
+
+Notes: Options are --threads (the largest thread count, default the
+number of hardware threads), --operations (per thread), --heap,
+--min-size, --max-size, --live (blocks kept alive per thread),
+--handoff, --policy and --seed. The thread counts are the powers of
+two up to --threads, and --threads itself. For every count the same
+workload runs on a ShardedMemoryManager with one shard per thread
+and on one with a single shard, which is one allocator behind one
+lock. Each thread does the same number of operations, so perfect
+scaling doubles the throughput with the thread count.
+***************************************************************/
+int runConcurrentBenchmark(int argc, char* argv[])
+{
+    WorkloadConfig config;
+    config.heapSize = 1 << 26;
+    string policyName = "best", value;
+    int maxThreads = max(1u, thread::hardware_concurrency()),
+        live = 1000;
+    long long operations = 1000000;
+    double handoff = 0.1;
+    for (int i = 2; i < argc; ++i) 
+    {
+        string argument = argv[i];
+        if (readOption(argument, "threads", value)) maxThreads = stoi(value);
+        else if (readOption(argument, "operations", value)) operations = stoll(value);
+        else if (readOption(argument, "heap", value)) config.heapSize = stoi(value);
+        else if (readOption(argument, "min-size", value)) config.minSize = stoi(value);
+        else if (readOption(argument, "max-size", value)) config.maxSize = stoi(value);
+        else if (readOption(argument, "live", value)) live = stoi(value);
+        else if (readOption(argument, "handoff", value)) handoff = stod(value);
+        else if (readOption(argument, "policy", value)) policyName = value;
+        else if (readOption(argument, "seed", value)) config.seed = stoul(value);
+        else 
+        {
+            cerr << "Unknown mtbench option " << argument << "\n";
+            return 1;
+        }
+    }
+    if (maxThreads < 1 || operations < 1 || live < 1 || config.minSize < 1 || config.maxSize < config.minSize || config.heapSize < maxThreads) 
+    {
+        cerr << "Threads, operations, live blocks and sizes must be positive, max-size at least min-size, and the heap at least one byte per thread.\n";
+        return 1;
+    }
+    if (!makePlacementPolicy<int>(policyName)) 
+    {
+        cerr << "Unknown placement policy " << policyName << ". Use first, next, best, worst, tlsf or buddy.\n";
+        return 1;
+    }
+
+    vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) 
+    {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    cout << "Policy: " << policyName << ", heap: " << config.heapSize << ", sizes: [" << config.minSize << ", " << config.maxSize << "], live blocks per thread: "
+         << live << ", handoff: " << handoff << ", operations per thread: " << operations << ", hardware threads: " << thread::hardware_concurrency() << "\n";
+    double singleLockBase = 0, shardedBase = 0;
+    for (int threads : threadCounts) 
+    {
+        ShardedMemoryManager singleLock(config.heapSize, 1, policyName), sharded(config.heapSize, threads, policyName);
+        double singleLockRate = runConcurrentRun(singleLock, threads, operations, config, live, handoff);
+        double shardedRate = runConcurrentRun(sharded, threads, operations, config, live, handoff);
+        if (singleLockRate < 0 || shardedRate < 0) 
+        {
+            cerr << "Consistency check failed with " << threads << " threads.\n";
+            return 1;
+        }
+        if (threads == threadCounts.front()) 
+        {
+            singleLockBase = singleLockRate;
+            shardedBase = shardedRate;
+        }
+        ShardStatistics counters = sharded.statistics();
+        cout << "Threads: " << threads << ", single lock: " << static_cast<long long>(singleLockRate) << " ops/sec (" << singleLockRate / singleLockBase
+             << "x), sharded: " << static_cast<long long>(shardedRate) << " ops/sec (" << shardedRate / shardedBase << "x, " << shardedRate / singleLockRate
+             << "x the single lock), stolen allocations: " << counters.stolenAllocations << ", remote frees: " << counters.remoteFrees
+             << ", failed allocations: " << counters.failedAllocations << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) 
+{
+    if (argc >= 2 && string(argv[1]) == "bench") 
+    {
+        return runBenchmark(argc, argv);
+    }
+    if (argc >= 2 && string(argv[1]) == "mtbench") 
+    {
+        return runConcurrentBenchmark(argc, argv);
+    }
+    if (argc >= 2 && string(argv[1]) == "convert") 
+    {
+        if (argc != 4) 
+        {
+            cerr << "Usage: convert <input trace> <output trace>\n";
+            return 1;
+        }
+        return convertTrace(argv[2], argv[3]);
+    }
+    if (argc < 3) 
+    {
+        cerr << "You must pass Total Memory Size and Defragmentation Interval.\n";
+        cerr << "Options: --input=<path> (default input.txt), --output=<path> (default output.txt),\n";
+        cerr << "         --policy=first|next|best|worst|tlsf|buddy, --verbosity=silent|errors|summary|full, --json, --stats, --arena, --pipeline, --compaction-threads=<n>, --slab-max-size=<n>,\n";
+        cerr << "         --address-bits=32|64 (default 64 only for heaps over 2 GB), --extent-only,\n";
+        cerr << "         --defrag=fixed|adaptive|incremental (default adaptive), --defrag-threshold=<0..1>, --defrag-cost=<weight>,\n";
+        cerr << "         --defrag-step-bytes=<n>, --defrag-step-blocks=<n>, --defrag-step-time=<microseconds>, --defrag-fit-budget=<n>\n";
+        cerr << "Or run \"bench [--option=value ...]\" for the synthetic workload benchmark,\n";
+        cerr << "\"mtbench [--option=value ...]\" for the multi-threaded benchmark of the sharded manager,\n";
+        cerr << "or \"convert <input trace> <output trace>\" to convert between text and binary traces.\n";
+        return 1;
+    }
+    long long totalMemorySize = stoll(argv[1]);
+    int k = stoi(argv[2]);
+    if(totalMemorySize < 1)
+    {
+        cerr << "Total Memory should be a natural number. Considering default case as 100. \n";
+        totalMemorySize=100;
+    }
+    if(k < 1)
+    {
+        cerr << "The period after which you want the compaction should occur should be a natural number. \n Considering default case as 1";
+        k=100;
+    }
+    string policyName = "best", inputPath = "input.txt", outputPath = "output.txt", verbosityName = "full", value;
+    DefragmentationOptions defragmentation;
+    HeapModel heapModel;
+    int compactionThreads = 1,
+        slabMaxSize = 0;
+    bool json = false,
+         dumpStatistics = false,
+         ownsArena = false,
+         pipelined = false;
+    for (int i = 3; i < argc; ++i) 
+    {
+        string option = argv[i];
+        if (option == "--json") 
+        {
+            json = true;
+        }
+        else if (option == "--stats") 
+        {
+            dumpStatistics = true;
+        }
+        else if (option == "--arena") 
+        {
+            ownsArena = true;
+        }
+        else if (option == "--pipeline") 
+        {
+            pipelined = true;
+        }
+        else if (readOption(option, "compaction-threads", value)) 
+        {
+            compactionThreads = stoi(value);
+        }
+        else if (readOption(option, "slab-max-size", value)) 
+        {
+            slabMaxSize = stoi(value);
+        }
+        else if (!readOption(option, "policy", policyName) && !readOption(option, "input", inputPath) && !readOption(option, "output", outputPath)
+                 && !readOption(option, "verbosity", verbosityName) && !readDefragmentationOption(option, defragmentation) && !readHeapModelOption(option, heapModel)) 
+        {
+            cerr << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    const string verbosityNames[] = {"silent", "errors", "summary", "full"};
+    auto verbosityIt = find(begin(verbosityNames), end(verbosityNames), verbosityName);
+    if (verbosityIt == end(verbosityNames)) 
+    {
+        cerr << "Unknown verbosity " << verbosityName << ". Use silent, errors, summary or full.\n";
+        return 1;
+    }
+    OutputSink::Level verbosity = static_cast<OutputSink::Level>(verbosityIt - begin(verbosityNames));
+    if (compactionThreads < 1) 
+    {
+        cerr << "The number of compaction threads must be at least 1.\n";
+        return 1;
+    }
+    if (!makePlacementPolicy<int>(policyName)) 
+    {
+        cerr << "Unknown placement policy " << policyName << ". Use first, next, best, worst, tlsf or buddy.\n";
+        return 1;
+    }
+    DefragmentationScheduler scheduler(DefragmentationScheduler::Adaptive, k);
+    if (!makeDefragmentationScheduler(defragmentation, k, scheduler) || !checkHeapModel(heapModel, totalMemorySize, ownsArena)
+        || !checkSlabMaxSize(slabMaxSize, totalMemorySize)) 
+    {
+        return 1;
+    }
+
+    // Binary traces are recognised by their header and streamed, text traces are memory-mapped
+    bool binaryInput = isBinaryTrace(inputPath);
+    MappedFile inputFile;
+    BinaryTraceReader binaryInputFile;
+    if (binaryInput ? !binaryInputFile.open(inputPath) : !inputFile.open(inputPath)) 
+    {
+        cerr << "Error opening input file.\n";
+        return 1;
+    }
+
+    OutputSink outputFile;
+    if (!outputFile.open(outputPath, verbosity, json)) 
+    {
+        cerr << "Error opening output file.\n";
+        return 1;
+    }
+    
+    return withMemoryManager(heapModel, totalMemorySize, policyName, ownsArena, [&](auto& memoryManager)
+    {
+        memoryManager.setCompactionThreads(compactionThreads);
+        memoryManager.setSlabMaxSize(slabMaxSize);
+        ReplayState state = {totalMemorySize, scheduler};
+        if (binaryInput) 
+        {
+            replayTrace([&](vector<Transaction>& batch)
+            {
+                Transaction transaction;
+                while (batch.size() < replayBatchSize) 
+                {
+                    if (!binaryInputFile.next(transaction)) 
+                    {
+                        return false;
+                    }
+                    batch.push_back(transaction);
+                }
+                return true;
+            }, memoryManager, state, outputFile, pipelined);
+            if (binaryInputFile.failed()) 
+            {
+                cerr << "Error: malformed binary trace.\n";
+                return 1;
+            }
+        }
+        else 
+        {
+            string_view remaining = inputFile.contents();
+            replayTrace([&](vector<Transaction>& batch)
+            {
+                while (!remaining.empty() && batch.size() < replayBatchSize) 
+                {
+                    size_t lineEnd = remaining.find('\n');
+                    string_view line = remaining.substr(0, lineEnd);
+                    remaining = lineEnd == string_view::npos ? string_view() : remaining.substr(lineEnd + 1);
+                    batch.push_back(parseTransaction(line));
+                }
+                return !remaining.empty();
+            }, memoryManager, state, outputFile, pipelined);
+        }
+        if (dumpStatistics) 
+        {
+            outputFile.beginTransaction("exit");
+            memoryManager.printStatistics(outputFile);
+        }
+        outputFile.close();
+        return 0;
+    });
 }
\ No newline at end of file